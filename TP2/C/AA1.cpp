@@ -54,20 +54,28 @@ char non_terminals[] = {'S', 'E', 'T', 'F'};
 const int NUM_TERMINALS = sizeof(terminals)/sizeof(char);
 const int NUM_NON_TERMINALS = sizeof(non_terminals)/sizeof(char);
 
+// Dense ID of each symbol character: terminals first, then non-terminals, -1 if unused
+int symbol_ids[256];
+
+// Fill symbol_ids from the terminal and non-terminal lists
+void init_symbol_ids() {
+    memset(symbol_ids, -1, sizeof(symbol_ids));
+    for (int i = 0; i < NUM_TERMINALS; i++) {
+        symbol_ids[(unsigned char)terminals[i]] = i;
+    }
+    for (int i = 0; i < NUM_NON_TERMINALS; i++) {
+        symbol_ids[(unsigned char)non_terminals[i]] = NUM_TERMINALS + i;
+    }
+}
+
 // Check if character is a non-terminal
 bool is_non_terminal(char c) {
-    return (c >= 'A' && c <= 'Z');
+    return symbol_ids[(unsigned char)c] >= NUM_TERMINALS;
 }
 
 // Get index for symbol
 int get_symbol_index(char symbol) {
-    for (int i = 0; i < NUM_TERMINALS; i++) {
-        if (terminals[i] == symbol) return i;
-    }
-    for (int i = 0; i < NUM_NON_TERMINALS; i++) {
-        if (non_terminals[i] == symbol) return NUM_TERMINALS + i;
-    }
-    return -1;
+    return symbol_ids[(unsigned char)symbol];
 }
 
 // Get symbol by index
@@ -247,6 +255,7 @@ void build_lr1_table(LR1State *states, int num_states, LR1Table *table) {
 
 //pour une affichage conviviale
 int main() {
+    init_symbol_ids();
     LR1State states[MAX_STATES];
     int num_states = 0;
     build_lr1_states(states, &num_states);
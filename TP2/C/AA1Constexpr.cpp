@@ -0,0 +1,406 @@
+// Version constexpr de AA1.cpp : la table LR(1) est construite à la compilation.
+// Compilation : g++ -std=c++20 -O2 AA1Constexpr.cpp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Grammaire de départ, une règle "X->rhs" par chaîne ; la règle 0 est la règle augmentée.
+// Les non-terminaux sont les symboles qui ont une règle, les autres sont des terminaux.
+constexpr const char *grammar_text[] = {
+    "S->E",     // S -> E (règle augmentée)
+    "E->E+T",   // E -> E + T
+    "E->T",     // E -> T
+    "T->T*F",   // T -> T * F
+    "T->F",     // T -> F
+    "F->(E)",   // F -> (E)
+    "F->d"      // F -> d
+};
+
+constexpr int NUM_RULES = sizeof(grammar_text) / sizeof(grammar_text[0]);
+
+// Capacités de la construction à la compilation ; en dépasser une arrête la compilation
+constexpr int MAX_RHS = 16;
+constexpr int MAX_TERMINALS = 64;      // Les ensembles de lookaheads sont des masques 64 bits, $ compris
+constexpr int MAX_NON_TERMINALS = 32;
+constexpr int MAX_STATES = 64;
+constexpr int MAX_ITEMS = 256;         // Items d'un état
+constexpr int INLINE_STACK = 64;       // États de la pile avant de passer sur le tas
+
+// Grammaire avec des indices de symboles denses : terminal t, non-terminal n
+struct Grammar {
+    int lhs[NUM_RULES];                // Indice du non-terminal
+    int rhs[NUM_RULES][MAX_RHS];       // t pour un terminal, MAX_TERMINALS + n pour un non-terminal
+    int length[NUM_RULES];
+    char terminals[MAX_TERMINALS];
+    char non_terminals[MAX_NON_TERMINALS];
+    int num_terminals;                 // '$' est le dernier terminal
+    int num_non_terminals;
+};
+
+// Indice d'un caractère dans une liste, -1 s'il n'y est pas
+constexpr int find_char(const char *list, int count, char c) {
+    for (int i = 0; i < count; i++) {
+        if (list[i] == c) return i;
+    }
+    return -1;
+}
+
+// Lire grammar_text dans une Grammar
+consteval Grammar read_grammar() {
+    Grammar g{};
+    for (int r = 0; r < NUM_RULES; r++) {
+        char lhs = grammar_text[r][0];
+        if (find_char(g.non_terminals, g.num_non_terminals, lhs) == -1) {
+            if (g.num_non_terminals == MAX_NON_TERMINALS) throw "trop de non-terminaux, augmenter MAX_NON_TERMINALS";
+            g.non_terminals[g.num_non_terminals++] = lhs;
+        }
+    }
+    for (int r = 0; r < NUM_RULES; r++) {
+        const char *text = grammar_text[r];
+        if (text[1] != '-' || text[2] != '>') throw "une règle s'écrit X->rhs";
+        g.lhs[r] = find_char(g.non_terminals, g.num_non_terminals, text[0]);
+        for (const char *c = text + 3; *c; c++) {
+            if (g.length[r] == MAX_RHS) throw "partie droite trop longue, augmenter MAX_RHS";
+            int n = find_char(g.non_terminals, g.num_non_terminals, *c);
+            if (n != -1) {
+                g.rhs[r][g.length[r]++] = MAX_TERMINALS + n;
+                continue;
+            }
+            int t = find_char(g.terminals, g.num_terminals, *c);
+            if (t == -1) {
+                if (g.num_terminals == MAX_TERMINALS - 1) throw "trop de terminaux, augmenter MAX_TERMINALS";
+                t = g.num_terminals;
+                g.terminals[g.num_terminals++] = *c;
+            }
+            g.rhs[r][g.length[r]++] = t;
+        }
+    }
+    g.terminals[g.num_terminals++] = '$';
+    return g;
+}
+
+// Structure pour représenter un item LR(1) : un cœur et son ensemble de lookaheads
+struct LR1Item {
+    int rule_index;
+    int dot_position;
+    uint64_t lookaheads;   // Bit t : terminal t
+};
+
+// Structure pour représenter un état LR(1)
+struct LR1State {
+    LR1Item items[MAX_ITEMS];
+    int num_items;
+};
+
+// Entrée ACTION : 0 erreur, (état << 2) | 1 shift, (règle << 2) | 2 reduce, 3 accept
+enum { ERROR = 0, SHIFT = 1, REDUCE = 2, ACCEPT = 3 };
+
+// Structure pour représenter la table LR(1)
+struct LR1Table {
+    Grammar grammar;
+    int num_states;
+    int action[MAX_STATES][MAX_TERMINALS];
+    int goto_table[MAX_STATES][MAX_NON_TERMINALS];   // -1 quand il n'y a pas de GOTO
+    int conflicts;
+    int8_t terminal_index[128];                      // Caractère -> terminal, -1 si ce n'est pas un terminal
+};
+
+// FIRST de chaque non-terminal en masque de terminaux, et ceux qui dérivent la chaîne vide
+struct FirstSets {
+    uint64_t first[MAX_NON_TERMINALS];
+    bool nullable[MAX_NON_TERMINALS];
+};
+
+// Calculer les FIRST par point fixe sur les règles
+consteval FirstSets compute_first(const Grammar &g) {
+    FirstSets f{};
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int r = 0; r < NUM_RULES; r++) {
+            int A = g.lhs[r];
+            uint64_t first = f.first[A];
+            bool nullable = true;
+            for (int k = 0; k < g.length[r] && nullable; k++) {
+                int X = g.rhs[r][k];
+                if (X < MAX_TERMINALS) {
+                    first |= uint64_t(1) << X;
+                    nullable = false;
+                } else {
+                    first |= f.first[X - MAX_TERMINALS];
+                    nullable = f.nullable[X - MAX_TERMINALS];
+                }
+            }
+            if (first != f.first[A] || (nullable && !f.nullable[A])) {
+                f.first[A] = first;
+                f.nullable[A] |= nullable;
+                changed = true;
+            }
+        }
+    }
+    return f;
+}
+
+// Fermeture : [A -> a.Bb, L] ajoute [B -> .y, FIRST(b L)], jusqu'à ce qu'aucun ensemble de lookaheads ne grossisse
+consteval void closure(LR1State &state, const Grammar &g, const FirstSets &f) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < state.num_items; i++) {
+            LR1Item item = state.items[i];
+            if (item.dot_position >= g.length[item.rule_index]) continue;
+            int B = g.rhs[item.rule_index][item.dot_position];
+            if (B < MAX_TERMINALS) continue;
+
+            // FIRST(b L)
+            uint64_t lookaheads = 0;
+            bool nullable = true;
+            for (int k = item.dot_position + 1; k < g.length[item.rule_index] && nullable; k++) {
+                int X = g.rhs[item.rule_index][k];
+                if (X < MAX_TERMINALS) {
+                    lookaheads |= uint64_t(1) << X;
+                    nullable = false;
+                } else {
+                    lookaheads |= f.first[X - MAX_TERMINALS];
+                    nullable = f.nullable[X - MAX_TERMINALS];
+                }
+            }
+            if (nullable) lookaheads |= item.lookaheads;
+
+            for (int j = 0; j < NUM_RULES; j++) {
+                if (MAX_TERMINALS + g.lhs[j] != B) continue;
+                int k = 0;
+                while (k < state.num_items && (state.items[k].rule_index != j || state.items[k].dot_position != 0)) k++;
+                if (k == state.num_items) {
+                    if (state.num_items == MAX_ITEMS) throw "état trop grand, augmenter MAX_ITEMS";
+                    state.items[state.num_items++] = LR1Item{j, 0, lookaheads};
+                    changed = true;
+                } else if ((state.items[k].lookaheads | lookaheads) != state.items[k].lookaheads) {
+                    state.items[k].lookaheads |= lookaheads;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+// Fonction goto : avancer le point sur le symbole X, puis fermer
+consteval LR1State goto_state(const LR1State &state, int X, const Grammar &g, const FirstSets &f) {
+    LR1State next{};
+    for (int i = 0; i < state.num_items; i++) {
+        LR1Item item = state.items[i];
+        if (item.dot_position < g.length[item.rule_index] && g.rhs[item.rule_index][item.dot_position] == X) {
+            next.items[next.num_items++] = LR1Item{item.rule_index, item.dot_position + 1, item.lookaheads};
+        }
+    }
+    if (next.num_items > 0) closure(next, g, f);
+    return next;
+}
+
+// Comparer des états : mêmes items, dans n'importe quel ordre
+consteval bool states_equal(const LR1State &a, const LR1State &b) {
+    if (a.num_items != b.num_items) return false;
+    for (int i = 0; i < a.num_items; i++) {
+        bool found = false;
+        for (int j = 0; j < b.num_items && !found; j++) {
+            found = a.items[i].rule_index == b.items[j].rule_index &&
+                    a.items[i].dot_position == b.items[j].dot_position &&
+                    a.items[i].lookaheads == b.items[j].lookaheads;
+        }
+        if (!found) return false;
+    }
+    return true;
+}
+
+// Construire la collection LR(1) canonique et sa table ; seule la table sort du compilateur
+consteval LR1Table build_lr1_table() {
+    LR1Table table{};
+    const Grammar &g = table.grammar = read_grammar();
+    FirstSets f = compute_first(g);
+    int end = g.num_terminals - 1;
+
+    for (int c = 0; c < 128; c++) table.terminal_index[c] = -1;
+    for (int t = 0; t < g.num_terminals; t++) table.terminal_index[(int)g.terminals[t]] = t;
+
+    // Construire les états LR(1), en remplissant les shifts et les GOTO au fil des transitions
+    LR1State states[MAX_STATES]{};
+    states[0].items[0] = LR1Item{0, 0, uint64_t(1) << end};
+    states[0].num_items = 1;
+    closure(states[0], g, f);
+    table.num_states = 1;
+    for (int i = 0; i < MAX_STATES; i++) {
+        for (int n = 0; n < MAX_NON_TERMINALS; n++) table.goto_table[i][n] = -1;
+    }
+
+    for (int i = 0; i < table.num_states; i++) {
+        for (int X = 0; X < MAX_TERMINALS + g.num_non_terminals; X++) {
+            if (X >= g.num_terminals && X < MAX_TERMINALS) continue;
+            LR1State next = goto_state(states[i], X, g, f);
+            if (next.num_items == 0) continue;
+
+            int target = 0;
+            while (target < table.num_states && !states_equal(next, states[target])) target++;
+            if (target == table.num_states) {
+                if (table.num_states == MAX_STATES) throw "trop d'états, augmenter MAX_STATES";
+                states[table.num_states++] = next;
+            }
+            if (X < MAX_TERMINALS) {
+                table.action[i][X] = target << 2 | SHIFT;
+            } else {
+                table.goto_table[i][X - MAX_TERMINALS] = target;
+            }
+        }
+    }
+
+    // Réductions : les conflits sont comptés, le shift l'emporte sur le reduce et la plus petite règle sur l'autre
+    for (int i = 0; i < table.num_states; i++) {
+        for (int k = 0; k < states[i].num_items; k++) {
+            LR1Item item = states[i].items[k];
+            if (item.dot_position < g.length[item.rule_index]) continue;
+            for (int t = 0; t < g.num_terminals; t++) {
+                if (!(item.lookaheads >> t & 1)) continue;
+                int action = item.rule_index == 0 ? ACCEPT : item.rule_index << 2 | REDUCE;
+                int &entry = table.action[i][t];
+                if (entry == ERROR) {
+                    entry = action;
+                } else if (entry != action) {
+                    table.conflicts++;
+                    if ((entry & 3) == REDUCE && (action >> 2) < (entry >> 2)) entry = action;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+constexpr LR1Table lr1_table = build_lr1_table();
+static_assert(lr1_table.conflicts == 0, "la grammaire n'est pas LR(1)");
+
+// Doubler la capacité d'une pile pleine, en quittant le tampon local si besoin
+int *grow_stack(int *stack, int *capacity, int *inline_stack) {
+    int *grown = (int *)malloc(2 * (size_t)*capacity * sizeof(int));
+    if (grown == NULL) {
+        printf("Erreur : mémoire insuffisante pour la pile\n");
+        exit(1);
+    }
+    memcpy(grown, stack, *capacity * sizeof(int));
+    if (stack != inline_stack) free(stack);
+    *capacity *= 2;
+    return grown;
+}
+
+// Analyseur LR(1) spécialisé sur une table connue à la compilation : chaque accès à la table
+// est une lecture à adresse constante, et les longueurs et LHS des règles se replient dans le code
+template <const LR1Table &T>
+bool parse(const char *input) {
+    int inline_stack[INLINE_STACK]; // Pile des états, d'abord locale
+    int *stack = inline_stack;
+    int capacity = INLINE_STACK;
+    int top = 0;
+    stack[0] = 0;
+    int index = 0;
+    bool accepted = false;
+    bool done = false;
+
+    while (!done) {
+        unsigned char c = input[index];
+        int t = c < 128 ? T.terminal_index[c] : -1;
+        if (t == -1) break;
+
+        int action = T.action[stack[top]][t];
+        int next = -1; // État à empiler, -1 pour arrêter
+        switch (action & 3) {
+            case SHIFT:
+                next = action >> 2;
+                index++;
+                break;
+            case REDUCE: {
+                int rule = action >> 2;
+                top -= T.grammar.length[rule];
+                next = T.goto_table[stack[top]][T.grammar.lhs[rule]];
+                break;
+            }
+            case ACCEPT:
+                accepted = true;
+                break;
+        }
+        if (next == -1) {
+            done = true;
+        } else {
+            // Empiler l'état, la pile ne grandit que lorsqu'elle est pleine
+            if (top + 1 == capacity) stack = grow_stack(stack, &capacity, inline_stack);
+            stack[++top] = next;
+        }
+    }
+    if (stack != inline_stack) free(stack);
+    return accepted;
+}
+
+// Lire le prochain mot de l'entrée dans un tampon qui grandit à la demande ; false à la fin
+bool read_word(char **word, int *capacity) {
+    int c = getchar();
+    while (c == ' ' || c == '\t' || c == '\n' || c == '\r') c = getchar();
+    if (c == EOF) return false;
+    int length = 0;
+    while (c != EOF && c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+        if (length + 1 >= *capacity) {
+            *capacity *= 2;
+            *word = (char *)realloc(*word, *capacity);
+            if (*word == NULL) {
+                printf("Erreur : mémoire insuffisante pour l'entrée\n");
+                exit(1);
+            }
+        }
+        (*word)[length++] = (char)c;
+        c = getchar();
+    }
+    (*word)[length] = 0;
+    return true;
+}
+
+//pour une affichage conviviale
+int main() {
+    const LR1Table &table = lr1_table;
+    const Grammar &g = table.grammar;
+
+    // Afficher la table LR(1)
+    printf("LR(1) Table (built at compile time, %d states):\n", table.num_states);
+    printf("State\t");
+    for (int t = 0; t < g.num_terminals; t++) printf("%c\t", g.terminals[t]);
+    for (int n = 0; n < g.num_non_terminals; n++) printf("%c\t", g.non_terminals[n]);
+    printf("\n");
+
+    for (int i = 0; i < table.num_states; i++) {
+        printf("%d\t", i);
+        // Afficher la table ACTION
+        for (int t = 0; t < g.num_terminals; t++) {
+            int action = table.action[i][t];
+            switch (action & 3) {
+                case SHIFT:  printf("s%d\t", action >> 2); break;
+                case REDUCE: printf("r%d\t", action >> 2); break;
+                case ACCEPT: printf("acc\t"); break;
+                default:     printf("\t"); break;
+            }
+        }
+        // Afficher la table GOTO
+        for (int n = 0; n < g.num_non_terminals; n++) {
+            if (table.goto_table[i][n] != -1) {
+                printf("%d\t", table.goto_table[i][n]);
+            } else {
+                printf("\t");
+            }
+        }
+        printf("\n");
+    }
+
+    // Analyse des chaînes lues sur l'entrée, terminées par $
+    int capacity = 1000;
+    char *input = (char *)malloc(capacity);
+    printf("\nEntrez une chaîne à analyser (terminée par $) :\n");
+    while (read_word(&input, &capacity)) {
+        printf("%s : %s\n", input, parse<lr1_table>(input) ? "acceptée" : "rejetée");
+    }
+    free(input);
+    return 0;
+}
@@ -3,8 +3,9 @@
 #include <string.h>
 #include <stdbool.h>
 
-#define MAX_STATES 10
+#define MAX_STATES 12
 #define MAX_SYMBOLS 10
+#define INLINE_STACK 64 // Entrées de la pile avant de passer sur le tas
 
 // Définir les symboles terminaux et non-terminaux
 enum Symbol {
@@ -13,11 +14,12 @@ enum Symbol {
 };
 
 // Définir les actions possibles dans la table LR(1)
+// ERROR vaut 0 : les cases non remplies de la table sont des erreurs
 enum ActionType {
+    ERROR,
     SHIFT,
     REDUCE,
-    ACCEPT,
-    ERROR
+    ACCEPT
 };
 
 // Structure pour représenter une action dans la table LR(1)
@@ -113,20 +115,39 @@ void initialize_tables() {
     goto_table[7][F] = 10;
 }
 
+// Doubler la capacité d'une pile pleine, en quittant le tampon local si besoin
+int *grow_stack(int *stack, int *capacity, int *inline_stack) {
+    int *grown = (int *)malloc(2 * (size_t)*capacity * sizeof(int));
+    if (grown == NULL) {
+        printf("Erreur : mémoire insuffisante pour la pile\n");
+        exit(1);
+    }
+    memcpy(grown, stack, *capacity * sizeof(int));
+    if (stack != inline_stack) free(stack);
+    *capacity *= 2;
+    return grown;
+}
+
 // Fonction pour analyser un mot en utilisant la table LR(1)
 bool parse_input(char *input) {
-    int stack[MAX_STATES * 2]; // Pile pour les états et symboles
+    int inline_stack[INLINE_STACK]; // Pile pour les états et symboles, d'abord locale
+    int *stack = inline_stack;
+    int capacity = INLINE_STACK;
     int top = 0;
     stack[top++] = 0; // État initial
 
     int input_pos = 0;
-    while (true) {
+    bool accepted = false;
+    bool done = false;
+    while (!done) {
         int state = stack[top - 1];
         int symbol = input[input_pos];
 
         Action action = action_table[state][symbol];
         switch (action.type) {
             case SHIFT:
+                // Empiler le symbole et l'état, la pile ne grandit que lorsqu'elle est pleine
+                if (top + 2 > capacity) stack = grow_stack(stack, &capacity, inline_stack);
                 stack[top++] = symbol;
                 stack[top++] = action.value;
                 input_pos++;
@@ -135,16 +156,22 @@ bool parse_input(char *input) {
                 Rule rule = rules[action.value];
                 top -= 2 * rule.rhs_len;
                 int new_state = stack[top - 1];
+                if (top + 2 > capacity) stack = grow_stack(stack, &capacity, inline_stack);
                 stack[top++] = rule.lhs;
                 stack[top++] = goto_table[new_state][rule.lhs];
                 break;
             }
             case ACCEPT:
-                return true;
+                accepted = true;
+                done = true;
+                break;
             case ERROR:
-                return false;
+                done = true;
+                break;
         }
     }
+    if (stack != inline_stack) free(stack);
+    return accepted;
 }
 
 // Fonction principale
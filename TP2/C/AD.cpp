@@ -40,6 +40,112 @@ typedef struct {
     char production[MAX_SYMBOLS];
 } LL1TableEntry;
 
+// ID dense de chaque caractère : terminaux d'abord, puis $, puis non-terminaux ; -1 si inutilisé
+int symbol_ids[256];
+int num_terminal_ids; // Les IDs inférieurs sont des terminaux ($ compris)
+
+// Remplit symbol_ids à partir des listes de la grammaire
+void init_symbol_ids(Grammar *g) {
+    memset(symbol_ids, -1, sizeof(symbol_ids));
+    for (int i = 0; i < g->num_terminals; i++) {
+        symbol_ids[(unsigned char)g->terminals[i]] = i;
+    }
+    symbol_ids['$'] = g->num_terminals;
+    num_terminal_ids = g->num_terminals + 1;
+    for (int i = 0; i < g->num_non_terminals; i++) {
+        symbol_ids[(unsigned char)g->non_terminals[i]] = num_terminal_ids + i;
+    }
+}
+
+// Vérifie si un symbole est un terminal ($ compris)
+bool is_terminal(char symbol) {
+    int id = symbol_ids[(unsigned char)symbol];
+    return id >= 0 && id < num_terminal_ids;
+}
+
+// Vérifie si un symbole est un non-terminal
+bool is_non_terminal(char symbol) {
+    return symbol_ids[(unsigned char)symbol] >= num_terminal_ids;
+}
+
+// Indice d'un non-terminal dans g.non_terminals (et dans le tableau FirstFollow)
+int non_terminal_index(char symbol) {
+    return symbol_ids[(unsigned char)symbol] - num_terminal_ids;
+}
+
+// Ajoute un symbole à un ensemble s'il n'y est pas, renvoie true s'il a été ajouté
+bool add_unique(char *set, int *count, char symbol) {
+    for (int i = 0; i < *count; i++) {
+        if (set[i] == symbol) return false;
+    }
+    set[(*count)++] = symbol;
+    return true;
+}
+
+// Graphe d'une relation entre non-terminaux pour l'algorithme digraph (DeRemer et Pennello) :
+// relation[x][y] signifie que l'ensemble de x contient celui de y
+typedef struct {
+    bool relation[MAX_NON_TERMINALS][MAX_NON_TERMINALS];
+    int depth[MAX_NON_TERMINALS]; // 0 : non visité, MAX_NON_TERMINALS + 1 : composante terminée
+    int stack[MAX_NON_TERMINALS];
+    int top;
+} Digraph;
+
+// Ensemble "First" ou "Follow" d'un non-terminal
+char *set_of(FirstFollow *ff, bool follow, int **count) {
+    *count = follow ? &ff->num_follow : &ff->num_first;
+    return follow ? ff->follow : ff->first;
+}
+
+// Ajoute l'ensemble de y à celui de x
+void union_sets(FirstFollow *first_follow, int x, int y, bool follow) {
+    int *count_x, *count_y;
+    char *set_x = set_of(&first_follow[x], follow, &count_x);
+    char *set_y = set_of(&first_follow[y], follow, &count_y);
+    for (int k = 0; k < *count_y; k++) {
+        add_unique(set_x, count_x, set_y[k]);
+    }
+}
+
+// Parcours de Tarjan depuis x : chaque arc est suivi une seule fois, et toute une composante
+// fortement connexe reçoit l'ensemble de sa racine
+void traverse(Digraph *d, FirstFollow *first_follow, int num_non_terminals, int x, bool follow) {
+    d->stack[d->top++] = x;
+    int depth = d->top;
+    d->depth[x] = depth;
+
+    for (int y = 0; y < num_non_terminals; y++) {
+        if (!d->relation[x][y]) continue;
+        if (d->depth[y] == 0) traverse(d, first_follow, num_non_terminals, y, follow);
+        if (d->depth[y] < d->depth[x]) d->depth[x] = d->depth[y];
+        union_sets(first_follow, x, y, follow);
+    }
+
+    if (d->depth[x] == depth) {
+        int y;
+        do {
+            y = d->stack[--d->top];
+            d->depth[y] = MAX_NON_TERMINALS + 1;
+            if (y != x) {
+                int *count_x, *count_y;
+                char *set_x = set_of(&first_follow[x], follow, &count_x);
+                char *set_y = set_of(&first_follow[y], follow, &count_y);
+                memcpy(set_y, set_x, *count_x);
+                *count_y = *count_x;
+            }
+        } while (y != x);
+    }
+}
+
+// Complète les ensembles initiaux selon la relation du graphe
+void digraph(Digraph *d, FirstFollow *first_follow, int num_non_terminals, bool follow) {
+    memset(d->depth, 0, sizeof(d->depth));
+    d->top = 0;
+    for (int x = 0; x < num_non_terminals; x++) {
+        if (d->depth[x] == 0) traverse(d, first_follow, num_non_terminals, x, follow);
+    }
+}
+
 // Fonction pour calculer l'ensemble "First"
 void calculate_first(Grammar g, FirstFollow *first_follow) {
     // Initialisation des ensembles "First"
@@ -48,61 +154,22 @@ void calculate_first(Grammar g, FirstFollow *first_follow) {
         first_follow[i].num_first = 0;
     }
 
-    // Calcul des ensembles "First"
-    bool changed;
-    do {
-        changed = false;
-        for (int i = 0; i < g.num_rules; i++) {
-            char non_terminal = g.rules[i].non_terminal;
-            char first_symbol = g.rules[i].production[0];
-
-            // Si le premier symbole est un terminal, l'ajouter à "First"
-            if (first_symbol >= 'a' && first_symbol <= 'z') {
-                for (int j = 0; j < g.num_non_terminals; j++) {
-                    if (first_follow[j].non_terminal == non_terminal) {
-                        bool exists = false;
-                        for (int k = 0; k < first_follow[j].num_first; k++) {
-                            if (first_follow[j].first[k] == first_symbol) {
-                                exists = true;
-                                break;
-                            }
-                        }
-                        if (!exists) {
-                            first_follow[j].first[first_follow[j].num_first++] = first_symbol;
-                            changed = true;
-                        }
-                        break;
-                    }
-                }
-            }
-            // Si le premier symbole est un non-terminal, ajouter son "First"
-            else if (first_symbol >= 'A' && first_symbol <= 'Z') {
-                for (int j = 0; j < g.num_non_terminals; j++) {
-                    if (first_follow[j].non_terminal == first_symbol) {
-                        for (int k = 0; k < first_follow[j].num_first; k++) {
-                            for (int l = 0; l < g.num_non_terminals; l++) {
-                                if (first_follow[l].non_terminal == non_terminal) {
-                                    bool exists = false;
-                                    for (int m = 0; m < first_follow[l].num_first; m++) {
-                                        if (first_follow[l].first[m] == first_follow[j].first[k]) {
-                                            exists = true;
-                                            break;
-                                        }
-                                    }
-                                    if (!exists) {
-                                        first_follow[l].first[first_follow[l].num_first++] = first_follow[j].first[k];
-                                        changed = true;
-                                    }
-                                    break;
-                                }
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
+    // Terminaux en tête de règle, et relation A -> B... : First(A) contient First(B)
+    Digraph d;
+    memset(d.relation, 0, sizeof(d.relation));
+    for (int i = 0; i < g.num_rules; i++) {
+        int lhs = non_terminal_index(g.rules[i].non_terminal);
+        char first_symbol = g.rules[i].production[0];
+
+        if (is_terminal(first_symbol)) {
+            add_unique(first_follow[lhs].first, &first_follow[lhs].num_first, first_symbol);
+        } else if (is_non_terminal(first_symbol)) {
+            d.relation[lhs][non_terminal_index(first_symbol)] = true;
         }
-    } while (changed);
+    }
+
+    // Calcul des ensembles "First"
+    digraph(&d, first_follow, g.num_non_terminals, false);
 }
 
 // Fonction pour calculer l'ensemble "Follow"
@@ -115,79 +182,37 @@ void calculate_follow(Grammar g, FirstFollow *first_follow) {
         }
     }
 
-    // Calcul des ensembles "Follow"
-    bool changed;
-    do {
-        changed = false;
-        for (int i = 0; i < g.num_rules; i++) {
-            char non_terminal = g.rules[i].non_terminal;
-            char *production = g.rules[i].production;
-
-            for (int j = 0; j < strlen(production); j++) {
-                if (production[j] >= 'A' && production[j] <= 'Z') { // Si c'est un non-terminal
-                    for (int k = 0; k < g.num_non_terminals; k++) {
-                        if (first_follow[k].non_terminal == production[j]) {
-                            if (j + 1 < strlen(production)) {
-                                char next_symbol = production[j + 1];
-                                if (next_symbol >= 'a' && next_symbol <= 'z') { // Terminal
-                                    bool exists = false;
-                                    for (int l = 0; l < first_follow[k].num_follow; l++) {
-                                        if (first_follow[k].follow[l] == next_symbol) {
-                                            exists = true;
-                                            break;
-                                        }
-                                    }
-                                    if (!exists) {
-                                        first_follow[k].follow[first_follow[k].num_follow++] = next_symbol;
-                                        changed = true;
-                                    }
-                                } else if (next_symbol >= 'A' && next_symbol <= 'Z') { // Non-terminal
-                                    for (int l = 0; l < g.num_non_terminals; l++) {
-                                        if (first_follow[l].non_terminal == next_symbol) {
-                                            for (int m = 0; m < first_follow[l].num_first; m++) {
-                                                bool exists = false;
-                                                for (int n = 0; n < first_follow[k].num_follow; n++) {
-                                                    if (first_follow[k].follow[n] == first_follow[l].first[m]) {
-                                                        exists = true;
-                                                        break;
-                                                    }
-                                                }
-                                                if (!exists) {
-                                                    first_follow[k].follow[first_follow[k].num_follow++] = first_follow[l].first[m];
-                                                    changed = true;
-                                                }
-                                            }
-                                            break;
-                                        }
-                                    }
-                                }
-                            } else { // Si c'est la fin de la production
-                                for (int l = 0; l < g.num_non_terminals; l++) {
-                                    if (first_follow[l].non_terminal == non_terminal) {
-                                        for (int m = 0; m < first_follow[l].num_follow; m++) {
-                                            bool exists = false;
-                                            for (int n = 0; n < first_follow[k].num_follow; n++) {
-                                                if (first_follow[k].follow[n] == first_follow[l].follow[m]) {
-                                                    exists = true;
-                                                    break;
-                                                }
-                                            }
-                                            if (!exists) {
-                                                first_follow[k].follow[first_follow[k].num_follow++] = first_follow[l].follow[m];
-                                                changed = true;
-                                            }
-                                        }
-                                        break;
-                                    }
-                                }
-                            }
-                            break;
-                        }
+    // Symboles qui suivent directement chaque non-terminal, et relation
+    // A -> ...B : Follow(B) contient Follow(A)
+    Digraph d;
+    memset(d.relation, 0, sizeof(d.relation));
+    for (int i = 0; i < g.num_rules; i++) {
+        int lhs = non_terminal_index(g.rules[i].non_terminal);
+        char *production = g.rules[i].production;
+        int length = strlen(production);
+
+        for (int j = 0; j < length; j++) {
+            if (!is_non_terminal(production[j])) continue;
+            FirstFollow *current = &first_follow[non_terminal_index(production[j])];
+
+            if (j + 1 < length) {
+                char next_symbol = production[j + 1];
+                if (is_terminal(next_symbol)) { // Terminal
+                    add_unique(current->follow, &current->num_follow, next_symbol);
+                } else if (is_non_terminal(next_symbol)) { // Non-terminal
+                    FirstFollow *next = &first_follow[non_terminal_index(next_symbol)];
+                    for (int m = 0; m < next->num_first; m++) {
+                        add_unique(current->follow, &current->num_follow, next->first[m]);
                     }
                 }
+            } else { // Si c'est la fin de la production
+                d.relation[non_terminal_index(production[j])][lhs] = true;
             }
         }
-    } while (changed);
+    }
+
+    // Calcul des ensembles "Follow"
+    digraph(&d, first_follow, g.num_non_terminals, true);
 }
 
 // Fonction pour construire la table LL(1)
@@ -198,34 +223,26 @@ void build_ll1_table(Grammar g, FirstFollow *first_follow, LL1TableEntry *ll1_ta
         char *production = g.rules[i].production;
         char first_symbol = production[0];
 
-        if (first_symbol >= 'a' && first_symbol <= 'z') { // Terminal
+        if (is_terminal(first_symbol)) { // Terminal
             ll1_table[*num_entries].non_terminal = non_terminal;
             ll1_table[*num_entries].terminal = first_symbol;
             strcpy(ll1_table[*num_entries].production, production);
             (*num_entries)++;
-        } else if (first_symbol >= 'A' && first_symbol <= 'Z') { // Non-terminal
-            for (int j = 0; j < g.num_non_terminals; j++) {
-                if (first_follow[j].non_terminal == first_symbol) {
-                    for (int k = 0; k < first_follow[j].num_first; k++) {
-                        ll1_table[*num_entries].non_terminal = non_terminal;
-                        ll1_table[*num_entries].terminal = first_follow[j].first[k];
-                        strcpy(ll1_table[*num_entries].production, production);
-                        (*num_entries)++;
-                    }
-                    break;
-                }
+        } else if (is_non_terminal(first_symbol)) { // Non-terminal
+            FirstFollow *rhs = &first_follow[non_terminal_index(first_symbol)];
+            for (int k = 0; k < rhs->num_first; k++) {
+                ll1_table[*num_entries].non_terminal = non_terminal;
+                ll1_table[*num_entries].terminal = rhs->first[k];
+                strcpy(ll1_table[*num_entries].production, production);
+                (*num_entries)++;
             }
         } else if (first_symbol == '\0') { // Production vide (epsilon)
-            for (int j = 0; j < g.num_non_terminals; j++) {
-                if (first_follow[j].non_terminal == non_terminal) {
-                    for (int k = 0; k < first_follow[j].num_follow; k++) {
-                        ll1_table[*num_entries].non_terminal = non_terminal;
-                        ll1_table[*num_entries].terminal = first_follow[j].follow[k];
-                        strcpy(ll1_table[*num_entries].production, production);
-                        (*num_entries)++;
-                    }
-                    break;
-                }
+            FirstFollow *lhs = &first_follow[non_terminal_index(non_terminal)];
+            for (int k = 0; k < lhs->num_follow; k++) {
+                ll1_table[*num_entries].non_terminal = non_terminal;
+                ll1_table[*num_entries].terminal = lhs->follow[k];
+                strcpy(ll1_table[*num_entries].production, production);
+                (*num_entries)++;
             }
         }
     }
@@ -298,7 +315,7 @@ bool ReadSyntaxe(char *input, Grammar g, LL1TableEntry *ll1_table, int num_entri
             return true;
         }
 
-        if (top_symbol >= 'a' && top_symbol <= 'z') {  // Terminal
+        if (is_terminal(top_symbol)) {  // Terminal
             if (top_symbol == symbol) {
                 index++;
                 symbol = input[index];
@@ -306,7 +323,7 @@ bool ReadSyntaxe(char *input, Grammar g, LL1TableEntry *ll1_table, int num_entri
                 printf("✗ Erreur syntaxique : attendu '%c', trouvé '%c'\n", top_symbol, symbol);
                 return false;
             }
-        } else if (top_symbol >= 'A' && top_symbol <= 'Z') {  // Non-terminal
+        } else if (is_non_terminal(top_symbol)) {  // Non-terminal
             // Chercher la règle dans la table LL(1)
             bool found = false;
             for (int i = 0; i < num_entries; i++) {
@@ -383,6 +400,8 @@ int main() {
     g.terminals[2] = 'c';
     g.terminals[3] = 'd';
 
+    init_symbol_ids(&g);
+
     // Calcul des ensembles FIRST et FOLLOW
     FirstFollow first_follow[MAX_NON_TERMINALS];
     calculate_first(g, first_follow);
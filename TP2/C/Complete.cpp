@@ -3,470 +3,2201 @@
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define MAX_RULES 50
-#define MAX_SYMBOLS 128
-#define MAX_STATES 100
-#define MAX_ITEMS 200
-#define MAX_RHS 20
-#define MAX_STACK 100
+#define MAX_TERMINALS 256      // Bits of a lookahead set, marker included
+#define MAX_SYMBOLS UINT16_MAX // Terminals and non-terminals together
+#define INLINE_STACK 64        // States a parse stack holds before it moves to the heap
 #define MAX_INPUT 1000
 #define MAX_LINE 1000
 #define EPSILON '%'  // ASCII character for epsilon
+#define EMPTY_NAME "%empty"    // Epsilon in grammar files
+#define END_SYMBOL 0           // ID of the end marker $
+#define NO_LOOKAHEAD -1        // Start lookahead of the LR(0) collection: every lookahead set stays empty
+#define PROPAGATE_LOOKAHEAD (MAX_TERMINALS - 1)  // Marker lookahead used to find LALR(1) propagation links
+#define MAX_RHS UINT8_MAX      // Longest RHS an item's dot position can walk
+#define ARENA_CHUNK 65536      // Bytes per arena chunk
+#define CACHE_MAGIC 0x4331524c // "LR1C", first bytes of a table cache file
+#define CACHE_VERSION 3        // Bump when the layout of a cache file changes
+
+// Growable array on the heap; elements stay contiguous, capacity doubles on demand
+template <typename T>
+struct Array {
+    T *data;
+    int size;
+    int capacity;
+
+    T &operator[](int i) { return data[i]; }
+    const T &operator[](int i) const { return data[i]; }
+};
+
+// Make room for at least capacity elements
+template <typename T>
+void array_reserve(Array<T> *array, int capacity) {
+    if (capacity <= array->capacity) return;
+    int new_capacity = array->capacity > 0 ? array->capacity : 16;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    array->data = (T *)realloc(array->data, (size_t)new_capacity * sizeof(T));
+    if (array->data == NULL) {
+        printf("Error: out of memory\n");
+        exit(1);
+    }
+    array->capacity = new_capacity;
+}
+
+// Set the number of elements, new elements are uninitialized
+template <typename T>
+void array_resize(Array<T> *array, int size) {
+    array_reserve(array, size);
+    array->size = size;
+}
+
+// Append an element and return it
+template <typename T>
+T *array_push(Array<T> *array, T value) {
+    array_reserve(array, array->size + 1);
+    array->data[array->size] = value;
+    return &array->data[array->size++];
+}
+
+// Release the storage of an array
+template <typename T>
+void array_free(Array<T> *array) {
+    free(array->data);
+    array->data = NULL;
+    array->size = array->capacity = 0;
+}
+
+// Bump allocator: memory comes from large chunks and never moves, so pointers stay valid
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t used;
+    size_t size;
+} ArenaChunk;
+
+typedef struct {
+    ArenaChunk *head;
+} Arena;
+
+// Allocate size bytes from the arena, aligned for any scalar type
+void *arena_alloc(Arena *arena, size_t size) {
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    ArenaChunk *chunk = arena->head;
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        size_t chunk_size = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+        chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + chunk_size);
+        if (chunk == NULL) {
+            printf("Error: out of memory\n");
+            exit(1);
+        }
+        chunk->next = arena->head;
+        chunk->used = 0;
+        chunk->size = chunk_size;
+        arena->head = chunk;
+    }
+    void *memory = (char *)(chunk + 1) + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+// Release every chunk of the arena
+void arena_free(Arena *arena) {
+    while (arena->head != NULL) {
+        ArenaChunk *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+// Dense symbol ID: terminals are 0 .. num_terminals - 1 ($ first), non-terminals follow
+typedef uint16_t Symbol;
 
 // Data structure definitions
 typedef struct {
-    char lhs;
-    char rhs[MAX_RHS];
+    Symbol lhs;
+    Symbol *rhs;  // Allocated from grammar_arena
     int length;
+    Symbol prec;  // Symbol named by %prec, END_SYMBOL when the rule has none
 } Rule;
 
+// Packed bitset over terminal IDs (and the marker lookahead)
+typedef uint64_t BitWord;
+#define WORD_BITS 64
+#define SET_WORDS ((MAX_TERMINALS + WORD_BITS - 1) / WORD_BITS)
+
 typedef struct {
-    int rule_index;
-    int dot_position;
-    char lookahead;
+    BitWord words[SET_WORDS];
+} SymbolSet;
+
+// LR(1) item with all of its lookaheads: one item per core (rule, dot position) in a set
+typedef struct {
+    uint32_t rule_index;
+    uint8_t dot_position;
+    SymbolSet lookaheads;  // Empty for LR(0) items
 } LR1Item;
 
+// State of a collection: a slice of the automaton's item pool
 typedef struct {
-    LR1Item items[MAX_ITEMS];
+    int first_item;
     int num_items;
+    uint32_t hash;  // Hash of the sorted items, see hash_items
 } LR1State;
 
+// Item set under construction (closure, GOTO kernels), canonical once sorted and hashed
+typedef struct {
+    Array<LR1Item> items;
+    uint32_t hash;
+} ItemSet;
+
+// GOTO edge of the automaton: from --symbol--> to
+typedef struct {
+    int from;
+    Symbol symbol;
+    int to;
+} Transition;
+
+// Canonical collection with its transition graph, edges grouped by source state
+typedef struct {
+    Array<LR1State> states;
+    Array<LR1Item> items;          // Items of every state, each state owns a slice
+    Array<int> index;              // Open-addressing intern table: state index or -1, size a power of two
+    Array<Transition> transitions;
+    Array<int> transition_start;   // Edges of state i: [transition_start[i], transition_start[i + 1])
+} LR1Automaton;
+
+// Kinds of ACTION entries; ACTION_ERROR is 0 so that a zeroed table is all errors
+enum ActionType {
+    ACTION_ERROR,
+    ACTION_SHIFT,
+    ACTION_REDUCE,
+    ACTION_ACCEPT,
+    ACTION_SHIFT_REDUCE  // Shift, then reduce at once by a rule ending in the shifted terminal
+};
+
+// ACTION entry packed as (value << 3) | type, value = target state or rule index
+typedef int32_t Action;
+#define ACTION_TYPE_BITS 3
+#define MAX_RULES (INT32_MAX >> ACTION_TYPE_BITS)  // Rules a REDUCE entry can number
+
+// Dense tables sized by the vocabulary: ACTION[state][terminal], GOTO[state][A - num_terminals]
 typedef struct {
-    char action[MAX_STATES][MAX_SYMBOLS][10];
-    int goto_table[MAX_STATES][MAX_SYMBOLS];
+    int num_states;
+    Action *action;       // num_states rows of num_terminals entries
+    int32_t *goto_table;  // num_states rows of num_non_terminals entries, -1 when there is no GOTO
+    int *rule_length;     // RHS length of each rule, for the driver
+    Symbol *rule_lhs;     // LHS of each rule, for the driver
+    Action *consistent;   // Per state: its only reduction if it has no other action, else 0
+    void *mapping;        // Cache file the arrays point into, NULL when they are malloc'd
+    size_t mapping_size;
 } LR1Table;
 
+// Pack an ACTION entry
+static inline Action make_action(int type, int value) {
+    return (Action)(value << ACTION_TYPE_BITS | type);
+}
+
+// Kind of an ACTION entry
+static inline int action_type(Action action) {
+    return action & ((1 << ACTION_TYPE_BITS) - 1);
+}
+
+// Target state of a shift, rule index of a reduce
+static inline int action_value(Action action) {
+    return action >> ACTION_TYPE_BITS;
+}
+
+// How the collection of states is built
+enum BuildMode {
+    BUILD_CANONICAL,  // Canonical LR(1)
+    BUILD_LALR,       // LALR(1): LR(0) states with propagated lookaheads
+    BUILD_PAGER       // Minimal LR(1): canonical states merged when weakly compatible
+};
+
+const char *build_mode_names[] = {"Canonical LR(1)", "LALR(1)", "Minimal LR(1) (Pager)"};
+
 // Grammar storage
-Rule grammar[MAX_RULES];
-int num_rules = 0;
-char terminals[MAX_SYMBOLS];
+Array<Rule> grammar;
+Arena grammar_arena;
+
+// Symbol table: names interned to dense IDs. While a grammar is read IDs follow the order
+// of first appearance; finalize_symbols then renumbers them, terminals first.
+Array<const char *> symbol_names;  // Allocated from grammar_arena
+Array<int> symbol_index;           // Open-addressing table of IDs by name, -1 when empty
 int num_terminals = 0;
-char non_terminals[MAX_SYMBOLS];
 int num_non_terminals = 0;
+int num_symbols = 0;
+const char *symbol_separator = "";  // Between the symbols of a RHS: "" for one-character grammars
+
+// Associativity of a %left, %right or %nonassoc declaration
+enum Associativity {
+    ASSOC_NONE,
+    ASSOC_LEFT,
+    ASSOC_RIGHT,
+    ASSOC_NONASSOC
+};
+
+// Precedence of a symbol: level 0 when undeclared, later declarations bind tighter
+typedef struct {
+    int level;
+    Associativity assoc;
+} Precedence;
+
+Array<Precedence> symbol_precedence;  // Indexed by symbol ID, may be shorter than the symbol table
+int num_precedence_levels = 0;
 
 // Check if a symbol is a terminal
-bool is_terminal(char symbol) {
-    for (int i = 0; i < num_terminals; i++) {
-        if (terminals[i] == symbol) return true;
-    }
-    return false;
+static inline bool is_terminal(Symbol symbol) {
+    return symbol < num_terminals;
 }
 
 // Check if a symbol is a non-terminal
-bool is_non_terminal(char symbol) {
-    for (int i = 0; i < num_non_terminals; i++) {
-        if (non_terminals[i] == symbol) return true;
+static inline bool is_non_terminal(Symbol symbol) {
+    return symbol >= num_terminals;
+}
+
+// FNV-1a hash of a name
+static inline uint32_t hash_name(const char *name, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
     }
-    return false;
+    return hash;
 }
 
-// Check if a rule can produce epsilon (empty string)
-bool can_derive_epsilon(char symbol) {
-    for (int r = 0; r < num_rules; r++) {
-        if (grammar[r].lhs == symbol && 
-           (grammar[r].length == 0 || 
-            (grammar[r].length == 1 && grammar[r].rhs[0] == EPSILON))) {
-            return true;
-        }
+// Find the slot holding a name, or the empty slot where it belongs
+int probe_symbol(const char *name, int length) {
+    int mask = symbol_index.size - 1;
+    int slot = hash_name(name, length) & mask;
+    while (symbol_index[slot] != -1) {
+        const char *other = symbol_names[symbol_index[slot]];
+        if ((int)strlen(other) == length && memcmp(other, name, length) == 0) break;
+        slot = (slot + 1) & mask;
     }
-    return false;
+    return slot;
 }
 
-// Calculate FIRST sets for a symbol
-void compute_first_sets(bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
-    bool changed;
-    
-    // Initialize: FIRST(a) = {a} for all terminals a
-    for (int i = 0; i < num_terminals; i++) {
-        char a = terminals[i];
-        first_sets[a][a] = true;
+// Rebuild the name table, with room for twice the current number of symbols
+void reindex_symbols() {
+    int buckets = 64;
+    while (buckets < 2 * symbol_names.size + 2) buckets *= 2;
+    array_resize(&symbol_index, buckets);
+    memset(symbol_index.data, -1, buckets * sizeof(int));
+    for (int id = 0; id < symbol_names.size; id++) {
+        symbol_index[probe_symbol(symbol_names[id], strlen(symbol_names[id]))] = id;
     }
-    
-    // Iterative calculation until no more changes
-    do {
-        changed = false;
-        
-        for (int i = 0; i < num_rules; i++) {
-            char A = grammar[i].lhs;
-            char *beta = grammar[i].rhs;
-            int len = grammar[i].length;
-            
-            if (len == 0) {
-                // A -> ε, add ε to FIRST(A)
-                if (!first_sets[A][EPSILON]) {
-                    first_sets[A][EPSILON] = true;
-                    changed = true;
-                }
-                continue;
-            }
-            
-            // For each symbol Y of B, add FIRST(Y) to FIRST(A)
-            for (int j = 0; j < len; j++) {
-                char Yj = beta[j];
-                
-                // Add FIRST(Yj) to FIRST(A), except epsilon
-                for (int k = 0; k < MAX_SYMBOLS; k++) {
-                    if (k != EPSILON && first_sets[Yj][k] && !first_sets[A][k]) {
-                        first_sets[A][k] = true;
-                        changed = true;
-                    }
-                }
-                
-                // If Yj cannot derive epsilon, stop
-                if (!can_derive_epsilon(Yj)) break;
-                
-                // If all symbols can derive epsilon, add epsilon to FIRST(A)
-                if (j == len - 1 && can_derive_epsilon(Yj) && !first_sets[A][EPSILON]) {
-                    first_sets[A][EPSILON] = true;
-                    changed = true;
-                }
-            }
-        }
-    } while (changed);
 }
 
-// Calculate FIRST for a string
-void first_of_string(char *str, int len, char lookahead, bool result[MAX_SYMBOLS], bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
-    if (len == 0) {
-        result[lookahead] = true;
-        return;
+// ID of a name, or -1 if the grammar does not use it
+int find_symbol(const char *name, int length) {
+    return symbol_index[probe_symbol(name, length)];
+}
+
+// ID of a name, added to the symbol table if new
+int intern_symbol(const char *name, int length) {
+    int slot = probe_symbol(name, length);
+    if (symbol_index[slot] != -1) return symbol_index[slot];
+    if (symbol_names.size == MAX_SYMBOLS) {
+        printf("Error: more than %d grammar symbols\n", MAX_SYMBOLS);
+        exit(1);
     }
-    
-    char first_sym = str[0];
-    
-    // Add FIRST(first_sym) to result, except epsilon
-    for (int i = 0; i < MAX_SYMBOLS; i++) {
-        if (i != EPSILON && first_sets[first_sym][i]) {
-            result[i] = true;
-        }
+
+    char *copy = (char *)arena_alloc(&grammar_arena, length + 1);
+    memcpy(copy, name, length);
+    copy[length] = 0;
+    int id = symbol_names.size;
+    array_push(&symbol_names, (const char *)copy);
+    symbol_index[slot] = id;
+    if (2 * symbol_names.size > symbol_index.size) reindex_symbols();
+    return id;
+}
+
+// Empty the grammar and the symbol table, $ gets ID END_SYMBOL
+void reset_grammar() {
+    grammar.size = 0;
+    symbol_names.size = 0;
+    arena_free(&grammar_arena);
+    reindex_symbols();
+    num_terminals = num_non_terminals = num_symbols = 0;
+    symbol_precedence.size = 0;
+    num_precedence_levels = 0;
+    intern_symbol("$", 1);
+}
+
+// Give a symbol the precedence level of a declaration
+void declare_precedence(Symbol symbol, int level, Associativity assoc) {
+    Precedence none = {0, ASSOC_NONE};
+    while (symbol_precedence.size <= symbol) array_push(&symbol_precedence, none);
+    if (symbol_precedence[symbol].level != 0) {
+        printf("Warning: precedence of %s declared twice, keeping the last one\n", symbol_names[symbol]);
     }
-    
-    // If first_sym can derive epsilon and there are other symbols, continue with the rest
-    if (can_derive_epsilon(first_sym) && len > 1) {
-        first_of_string(str + 1, len - 1, lookahead, result, first_sets);
+    symbol_precedence[symbol].level = level;
+    symbol_precedence[symbol].assoc = assoc;
+}
+
+// Associativity named by a declaration keyword, ASSOC_NONE if it is none of them
+Associativity parse_associativity(const char *keyword, int length) {
+    if (length == 5 && strncmp(keyword, "%left", 5) == 0) return ASSOC_LEFT;
+    if (length == 6 && strncmp(keyword, "%right", 6) == 0) return ASSOC_RIGHT;
+    if (length == 9 && strncmp(keyword, "%nonassoc", 9) == 0) return ASSOC_NONASSOC;
+    return ASSOC_NONE;
+}
+
+// Renumber the symbols once the grammar is read: terminals (symbols with no rule) first, in
+// order of appearance, then non-terminals; every ID in the rules is rewritten
+void finalize_symbols() {
+    int count = symbol_names.size;
+    bool *has_rule = (bool *)calloc(count, sizeof(bool));
+    int *new_id = (int *)malloc(count * sizeof(int));
+    for (int r = 0; r < grammar.size; r++) has_rule[grammar[r].lhs] = true;
+
+    num_terminals = num_non_terminals = 0;
+    for (int id = 0; id < count; id++) {
+        if (!has_rule[id]) new_id[id] = num_terminals++;
+    }
+    for (int id = 0; id < count; id++) {
+        if (has_rule[id]) new_id[id] = num_terminals + num_non_terminals++;
+    }
+    num_symbols = count;
+    if (num_terminals > PROPAGATE_LOOKAHEAD) {
+        printf("Error: more than %d terminals\n", PROPAGATE_LOOKAHEAD);
+        exit(1);
+    }
+
+    for (int r = 0; r < grammar.size; r++) {
+        grammar[r].lhs = new_id[grammar[r].lhs];
+        grammar[r].prec = new_id[grammar[r].prec];
+        for (int k = 0; k < grammar[r].length; k++) grammar[r].rhs[k] = new_id[grammar[r].rhs[k]];
+    }
+    const char **names = (const char **)malloc(count * sizeof(const char *));
+    for (int id = 0; id < count; id++) names[new_id[id]] = symbol_names[id];
+    memcpy(symbol_names.data, names, count * sizeof(const char *));
+    reindex_symbols();
+
+    // Precedences follow their symbols, undeclared ones get level 0
+    Precedence *precedence = (Precedence *)calloc(count, sizeof(Precedence));
+    for (int id = 0; id < symbol_precedence.size; id++) precedence[new_id[id]] = symbol_precedence[id];
+    array_resize(&symbol_precedence, count);
+    memcpy(symbol_precedence.data, precedence, count * sizeof(Precedence));
+
+    free(has_rule);
+    free(new_id);
+    free(names);
+    free(precedence);
+}
+
+// Precedence level of a rule: that of its %prec symbol, else of its last terminal, else 0
+int rule_precedence(const Rule *rule) {
+    if (rule->prec != END_SYMBOL) return symbol_precedence[rule->prec].level;
+    for (int k = rule->length - 1; k >= 0; k--) {
+        if (is_terminal(rule->rhs[k])) return symbol_precedence[rule->rhs[k]].level;
     }
-    // If first_sym can derive epsilon and it's the last symbol, add lookahead
-    else if (can_derive_epsilon(first_sym) && len == 1) {
-        result[lookahead] = true;
+    return 0;
+}
+
+// One non-terminal C of the closure template of B: closing [B -> .y, L] adds every
+// [C -> .d] with lookaheads spontaneous, plus L if inherits
+typedef struct {
+    Symbol non_terminal;
+    bool inherits;
+    SymbolSet spontaneous;
+} TemplateEntry;
+
+// FIRST sets and nullability of every symbol, indexed by ID (epsilon is kept out of the sets),
+// and of every rule suffix: suffix (rule, dot) is at suffix_start[rule] + dot, dot = length included.
+// Also the closure template of every non-terminal, built from them; arrays indexed by
+// non-terminal are indexed by B - num_terminals
+typedef struct {
+    SymbolSet *first;
+    bool *nullable;
+    int *suffix_start;
+    SymbolSet *suffix_first;
+    bool *suffix_nullable;
+    int *rule_start;           // Rules of B: rules_of[rule_start[B] .. rule_start[B + 1]]
+    int *rules_of;
+    int *template_start;       // Template of B: templates[template_start[B] .. template_start[B + 1]]
+    TemplateEntry *templates;
+} FirstSets;
+
+// Add a symbol to a set
+static inline void set_add(SymbolSet *set, int symbol) {
+    set->words[symbol / WORD_BITS] |= (BitWord)1 << (symbol % WORD_BITS);
+}
+
+// Check if a symbol belongs to a set
+static inline bool set_contains(const SymbolSet *set, int symbol) {
+    return (set->words[symbol / WORD_BITS] >> (symbol % WORD_BITS)) & 1;
+}
+
+// Remove a symbol from a set
+static inline void set_remove(SymbolSet *set, int symbol) {
+    set->words[symbol / WORD_BITS] &= ~((BitWord)1 << (symbol % WORD_BITS));
+}
+
+// Check if two sets hold the same symbols
+static inline bool set_equal(const SymbolSet *a, const SymbolSet *b) {
+    for (int w = 0; w < SET_WORDS; w++) {
+        if (a->words[w] != b->words[w]) return false;
     }
+    return true;
 }
 
-// Check if two LR(1) items are identical
-bool items_equal(LR1Item item1, LR1Item item2) {
-    return item1.rule_index == item2.rule_index && 
-           item1.dot_position == item2.dot_position && 
-           item1.lookahead == item2.lookahead;
+// dst |= src, returns true if dst gained at least one symbol
+static inline bool set_union(SymbolSet *dst, const SymbolSet *src) {
+    BitWord added = 0;
+    for (int w = 0; w < SET_WORDS; w++) {
+        added |= src->words[w] & ~dst->words[w];
+        dst->words[w] |= src->words[w];
+    }
+    return added != 0;
 }
 
-// Check if an item already exists in a set
-bool item_exists(LR1State *state, LR1Item item) {
-    for (int i = 0; i < state->num_items; i++) {
-        if (items_equal(state->items[i], item)) {
-            return true;
-        }
+// Return the smallest symbol of the set that is >= from, or -1
+static inline int set_next(const SymbolSet *set, int from) {
+    for (int w = from / WORD_BITS; w < SET_WORDS; w++) {
+        BitWord bits = set->words[w];
+        if (w == from / WORD_BITS) bits &= ~(BitWord)0 << (from % WORD_BITS);
+        if (bits != 0) return w * WORD_BITS + __builtin_ctzll(bits);
     }
-    return false;
+    return -1;
 }
 
-// Calculate the closure of a set of LR(1) items
-void closure(LR1State *state, bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
+// Calculate which non-terminals derive the empty string
+void compute_nullable(bool *nullable) {
+    bool *rule_done = (bool *)calloc(grammar.size, sizeof(bool));
     bool changed;
-    
+
+    // A rule is nullable once every RHS symbol is; a rule that has fired is never revisited
     do {
         changed = false;
-        
-        for (int i = 0; i < state->num_items; i++) {
-            LR1Item item = state->items[i];
-            Rule rule = grammar[item.rule_index];
-            
-            // Check if the dot is before a non-terminal
-            if (item.dot_position < rule.length) {
-                char B = rule.rhs[item.dot_position];
-                
-                if (is_non_terminal(B)) {
-                    // Remove the dynamic non-terminal addition
-                    // Calculate FIRST(βa)
-                    bool first_beta_a[MAX_SYMBOLS] = {false};
-                    
-                    if (item.dot_position + 1 < rule.length) {
-                        // Beta exists, calculate FIRST(beta a)
-                        char beta[MAX_RHS];
-                        int beta_len = 0;
-                        for (int j = item.dot_position + 1; j < rule.length; j++) {
-                            beta[beta_len++] = rule.rhs[j];
-                        }
-                        first_of_string(beta, beta_len, item.lookahead, first_beta_a, first_sets);
-                    } else {
-                        // No beta, lookahead is added directly
-                        first_beta_a[item.lookahead] = true;
-                    }
-                    
-                    // For each production B -> y, add [B -> .y, b] to the closure
-                    for (int j = 0; j < num_rules; j++) {
-                        if (grammar[j].lhs == B) {
-                            for (int k = 0; k < MAX_SYMBOLS; k++) {
-                                if (first_beta_a[k]) {
-                                    LR1Item new_item = {j, 0, (char)k};
-                                    if (!item_exists(state, new_item)) {
-                                        if (state->num_items < MAX_ITEMS) {
-                                            state->items[state->num_items++] = new_item;
-                                            changed = true;
-                                        } else {
-                                            printf("Warning: MAX_ITEMS reached\n");
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+
+        for (int i = 0; i < grammar.size; i++) {
+            if (rule_done[i] || nullable[grammar[i].lhs]) continue;
+
+            int j = 0;
+            while (j < grammar[i].length && nullable[grammar[i].rhs[j]]) j++;
+
+            if (j == grammar[i].length) {
+                nullable[grammar[i].lhs] = true;
+                rule_done[i] = true;
+                changed = true;
             }
         }
     } while (changed);
+
+    free(rule_done);
 }
 
-// Calculate GOTO(I, X)
-LR1State goto_state(LR1State state, char symbol, bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
-    LR1State new_state = {0};
-    
-    for (int i = 0; i < state.num_items; i++) {
-        LR1Item item = state.items[i];
-        Rule rule = grammar[item.rule_index];
-        
-        if (item.dot_position < rule.length && rule.rhs[item.dot_position] == symbol) {
-            LR1Item new_item = {
-                item.rule_index,
-                item.dot_position + 1,
-                item.lookahead
-            };
-            new_state.items[new_state.num_items++] = new_item;
-        }
-    }
-    
-    if (new_state.num_items > 0) {
-        closure(&new_state, first_sets);
+// Calculate FIRST and nullability of every rule suffix, from the end of each rule backwards
+void compute_suffix_first(FirstSets *first_sets) {
+    first_sets->suffix_start = (int *)malloc((grammar.size + 1) * sizeof(int));
+    int total = 0;
+    for (int i = 0; i < grammar.size; i++) {
+        first_sets->suffix_start[i] = total;
+        total += grammar[i].length + 1;
     }
-    
-    return new_state;
-}
+    first_sets->suffix_start[grammar.size] = total;
+    first_sets->suffix_first = (SymbolSet *)calloc(total, sizeof(SymbolSet));
+    first_sets->suffix_nullable = (bool *)calloc(total, sizeof(bool));
 
-// Check if two states are identical
-bool states_equal(LR1State state1, LR1State state2) {
-    if (state1.num_items != state2.num_items) return false;
-    
-    for (int i = 0; i < state1.num_items; i++) {
-        if (!item_exists(&state2, state1.items[i])) {
-            return false;
+    for (int i = 0; i < grammar.size; i++) {
+        SymbolSet *first = &first_sets->suffix_first[first_sets->suffix_start[i]];
+        bool *nullable = &first_sets->suffix_nullable[first_sets->suffix_start[i]];
+        int length = grammar[i].length;
+
+        // FIRST(X beta) = FIRST(X), plus FIRST(beta) if X can vanish
+        nullable[length] = true;
+        for (int dot = length - 1; dot >= 0; dot--) {
+            Symbol X = grammar[i].rhs[dot];
+            first[dot] = first_sets->first[X];
+            if (first_sets->nullable[X]) {
+                set_union(&first[dot], &first[dot + 1]);
+                nullable[dot] = nullable[dot + 1];
+            }
         }
     }
-    
-    return true;
 }
 
-// Find the index of a state in the collection, or -1 if it doesn't exist
-int find_state(LR1State *states, int num_states, LR1State state) {
-    for (int i = 0; i < num_states; i++) {
-        if (states_equal(states[i], state)) {
-            return i;
-        }
-    }
-    return -1;
+// FIRST of the part of a rule after position dot
+static inline const SymbolSet *suffix_first(const FirstSets *first_sets, int rule_index, int dot) {
+    return &first_sets->suffix_first[first_sets->suffix_start[rule_index] + dot];
 }
 
-// Build the canonical collection of LR(1) states
-void build_lr1_states(LR1State *states, int *num_states, bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
-    // Initial state with [S' -> .S, $] (assuming grammar[0] is S' -> S)
-    LR1State initial_state = {0};
-    // Ensure grammar[0] is the augmented rule S' -> OriginalStartSymbol
-    if (num_rules == 0) {
-        printf("Error: Cannot build states, grammar is empty or not augmented.\n");
-        return;
-    }
-    LR1Item initial_item = {0, 0, '$'}; // Rule 0, dot at start, lookahead $
-    initial_state.items[0] = initial_item;
-    initial_state.num_items = 1;
-    
-    // Calculate the closure of the initial state
-    closure(&initial_state, first_sets);
-    states[0] = initial_state;
-    *num_states = 1;
-    
-    // Build other states
-    int i = 0;
-    while (i < *num_states) {
-        // For each grammar symbol (terminals and non-terminals)
-        for (int t = 0; t < num_terminals; t++) {
-            char symbol = terminals[t];
-            LR1State new_state = goto_state(states[i], symbol, first_sets);
-            
-            if (new_state.num_items > 0) {
-                int state_idx = find_state(states, *num_states, new_state);
-                if (state_idx == -1) {
-                    if (*num_states < MAX_STATES) {
-                        states[*num_states] = new_state;
-                        (*num_states)++;
-                    } else {
-                        printf("Warning: MAX_STATES reached\n");
+// Check if the part of a rule after position dot can vanish
+static inline bool suffix_nullable(const FirstSets *first_sets, int rule_index, int dot) {
+    return first_sets->suffix_nullable[first_sets->suffix_start[rule_index] + dot];
+}
+
+// Calculate the closure template of every non-terminal B: the non-terminals whose rules
+// closing [B -> .y, L] adds, and the lookaheads they get from the template itself or from L
+void compute_closure_templates(FirstSets *first_sets) {
+    int count = num_non_terminals;
+
+    // Rules grouped by left-hand side
+    first_sets->rule_start = (int *)calloc(count + 1, sizeof(int));
+    first_sets->rules_of = (int *)malloc(grammar.size * sizeof(int));
+    for (int i = 0; i < grammar.size; i++) first_sets->rule_start[grammar[i].lhs - num_terminals + 1]++;
+    for (int B = 0; B < count; B++) first_sets->rule_start[B + 1] += first_sets->rule_start[B];
+    int *fill = (int *)malloc(count * sizeof(int));
+    memcpy(fill, first_sets->rule_start, count * sizeof(int));
+    for (int i = 0; i < grammar.size; i++) first_sets->rules_of[fill[grammar[i].lhs - num_terminals]++] = i;
+    free(fill);
+
+    // Per B, a fixpoint over the left corners C of B: [C -> .X d] passes FIRST(d) to X,
+    // and the lookaheads of C too when d can vanish
+    Array<TemplateEntry> templates = {NULL, 0, 0};
+    int *entry_of = (int *)malloc(count * sizeof(int));
+    memset(entry_of, -1, count * sizeof(int));
+    first_sets->template_start = (int *)malloc((count + 1) * sizeof(int));
+    for (int B = 0; B < count; B++) {
+        int start = templates.size;
+        first_sets->template_start[B] = start;
+        TemplateEntry root = {(Symbol)(num_terminals + B), true, {{0}}};
+        array_push(&templates, root);
+        entry_of[B] = start;
+
+        bool changed;
+        do {
+            changed = false;
+            for (int e = start; e < templates.size; e++) {
+                int C = templates[e].non_terminal - num_terminals;
+                for (int r = first_sets->rule_start[C]; r < first_sets->rule_start[C + 1]; r++) {
+                    int j = first_sets->rules_of[r];
+                    if (grammar[j].length == 0 || is_terminal(grammar[j].rhs[0])) continue;
+
+                    Symbol X = grammar[j].rhs[0];
+                    if (entry_of[X - num_terminals] == -1) {
+                        TemplateEntry entry = {X, false, {{0}}};
+                        entry_of[X - num_terminals] = templates.size;
+                        array_push(&templates, entry);
+                        changed = true;
                     }
-                }
-            }
-        }
-        
-        for (int n = 0; n < num_non_terminals; n++) {
-            char symbol = non_terminals[n];
-            LR1State new_state = goto_state(states[i], symbol, first_sets);
-            
-            if (new_state.num_items > 0) {
-                int state_idx = find_state(states, *num_states, new_state);
-                if (state_idx == -1) {
-                    if (*num_states < MAX_STATES) {
-                        states[*num_states] = new_state;
-                        (*num_states)++;
-                    } else {
-                        printf("Warning: MAX_STATES reached\n");
+                    // Entries may have moved, index them only after the push
+                    TemplateEntry *from = &templates[e];
+                    TemplateEntry *to = &templates[entry_of[X - num_terminals]];
+                    if (set_union(&to->spontaneous, suffix_first(first_sets, j, 1))) changed = true;
+                    if (suffix_nullable(first_sets, j, 1)) {
+                        if (set_union(&to->spontaneous, &from->spontaneous)) changed = true;
+                        if (from->inherits && !to->inherits) {
+                            to->inherits = true;
+                            changed = true;
+                        }
                     }
                 }
             }
-        }
-        
-        i++;
+        } while (changed);
+
+        for (int e = start; e < templates.size; e++) entry_of[templates[e].non_terminal - num_terminals] = -1;
     }
+    first_sets->template_start[count] = templates.size;
+    first_sets->templates = templates.data;
+    free(entry_of);
 }
 
-// Build the LR(1) parsing table
-void build_lr1_table(LR1State *states, int num_states, LR1Table *table, bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS]) {
-    // Initialize tables
-    memset(table->action, 0, sizeof(table->action));
-    for (int i = 0; i < MAX_STATES; i++) {
-        for (int j = 0; j < MAX_SYMBOLS; j++) {
-            table->goto_table[i][j] = -1;
+// Calculate FIRST of every non-terminal by sweeping the rules until nothing changes:
+// one pass per step of the longest dependency chain. Kept as the reference for --bench-first
+int sweep_first(SymbolSet *first, const bool *nullable) {
+    int passes = 0;
+    bool changed;
+    do {
+        changed = false;
+        passes++;
+
+        for (int i = 0; i < grammar.size; i++) {
+            SymbolSet *first_a = &first[grammar[i].lhs];
+
+            // Add FIRST(Y1..Yk) to FIRST(A), stopping at the first non-nullable Yj
+            for (int j = 0; j < grammar[i].length; j++) {
+                Symbol Yj = grammar[i].rhs[j];
+                if (set_union(first_a, &first[Yj])) changed = true;
+                if (!nullable[Yj]) break;
+            }
         }
-    }
-    
-    // First, calculate all GOTO transitions for each state and non-terminal
-    for (int i = 0; i < num_states; i++) {
-        for (int n = 0; n < num_non_terminals; n++) {
-            char symbol = non_terminals[n];
-            LR1State new_state = goto_state(states[i], symbol, first_sets);
-            
-            if (new_state.num_items > 0) {
-                int target = find_state(states, num_states, new_state);
-                if (target != -1) {
-                    table->goto_table[i][symbol] = target;
-                }
+    } while (changed);
+    return passes;
+}
+
+// Calculate FIRST of every non-terminal with the digraph algorithm (DeRemer and Pennello 1982):
+// FIRST(A) is the union of the terminals that directly start a rule of A and of FIRST(B) over
+// the relation A -> a B b with a nullable. Tarjan's walk visits each edge once and gives every
+// strongly connected component one shared set. The walk keeps its own stack, deep chains are fine
+void digraph_first(SymbolSet *first, const bool *nullable) {
+    int count = num_non_terminals;
+
+    // Edges of the relation in CSR form, indexed by A - num_terminals: count the edges of
+    // every A, then fill them in; the direct terminals go straight into first[A]
+    int *edge_start = (int *)calloc(count + 1, sizeof(int));
+    for (int i = 0; i < grammar.size; i++) {
+        for (int j = 0; j < grammar[i].length; j++) {
+            Symbol Yj = grammar[i].rhs[j];
+            if (is_terminal(Yj)) {
+                set_add(&first[grammar[i].lhs], Yj);
+            } else {
+                edge_start[grammar[i].lhs - num_terminals + 1]++;
             }
+            if (!nullable[Yj]) break;
         }
     }
-    
-    // Then fill the ACTION table
-    for (int i = 0; i < num_states; i++) {
-        // For each item in state i
-        for (int j = 0; j < states[i].num_items; j++) {
-            LR1Item item = states[i].items[j];
-            Rule rule = grammar[item.rule_index];
-            
-            if (item.dot_position < rule.length) {
-                // [A -> α.Xb, a], X is the symbol after the dot
-                char X = rule.rhs[item.dot_position];
-                
-                // If X is a terminal, add a shift action
-                if (is_terminal(X)) {
-                    LR1State new_state = goto_state(states[i], X, first_sets);
-                    int target = find_state(states, num_states, new_state);
-                    
-                    if (target != -1) {
-                        // Shift action:
-                        if (table->action[i][X][0] == 0) {
-                            sprintf(table->action[i][X], "s%d", target);
-                        } else if (strncmp(table->action[i][X], "s", 1) != 0) {
-                            printf("Conflict in state %d for symbol %c: %s vs s%d\n", 
-                                   i, X, table->action[i][X], target);
-                            // Conflict resolution: prefer shift action
-                            sprintf(table->action[i][X], "s%d", target);
-                        }
-                    }
-                }
-                // We don't need to handle non-terminals here anymore since we did it above
-            } else {
-                // [A -> b., a], the dot is at the end, add a reduce action
-                if (item.rule_index == 0 && item.lookahead == '$') {
-                    // S' -> S., $ -> accept
-                    if (table->action[i]['$'][0] == 0) {
-                        strcpy(table->action[i]['$'], "acc");
-                    } else {
-                        printf("Conflict in state %d for symbol $: %s vs acc\n", 
-                               i, table->action[i]['$']);
-                        // Accept should always take priority
-                        strcpy(table->action[i]['$'], "acc");
-                    }
-                } else {
-                    // A -> b., a -> reduce by A -> b
-                    char a = item.lookahead;
-                    if (table->action[i][a][0] == 0) {
-                        sprintf(table->action[i][a], "r%d", item.rule_index);
-                    } else {
-                        // Conflict detected
-                        if (strncmp(table->action[i][a], "r", 1) == 0) {
-                            // Reduce-Reduce conflict
-                            int existing_rule;
-                            sscanf(table->action[i][a], "r%d", &existing_rule);
-                            printf("Reduce-Reduce conflict in state %d for symbol %c: r%d vs r%d\n", 
-                                   i, a, existing_rule, item.rule_index);
-                            
-                            // Resolution by rule priority (choose rule with lower index)
-                            if (item.rule_index < existing_rule) {
-                                sprintf(table->action[i][a], "r%d", item.rule_index);
-                            }
-                        } else if (strncmp(table->action[i][a], "s", 1) == 0) {
-                            // Shift-Reduce conflict
-                            int shift_state;
-                            sscanf(table->action[i][a], "s%d", &shift_state);
-                            printf("Shift-Reduce conflict in state %d for symbol %c: s%d vs r%d\n", 
-                                   i, a, shift_state, item.rule_index);
-                            
-                            // By default, prefer shift (do nothing)
-                            // For operator precedence, additional logic could be added here
-                        }
-                    }
+    for (int A = 0; A < count; A++) edge_start[A + 1] += edge_start[A];
+
+    int *edges = (int *)malloc((edge_start[count] + 1) * sizeof(int));
+    int *fill = (int *)malloc(count * sizeof(int));
+    memcpy(fill, edge_start, count * sizeof(int));
+    for (int i = 0; i < grammar.size; i++) {
+        for (int j = 0; j < grammar[i].length; j++) {
+            Symbol Yj = grammar[i].rhs[j];
+            if (is_non_terminal(Yj)) edges[fill[grammar[i].lhs - num_terminals]++] = Yj - num_terminals;
+            if (!nullable[Yj]) break;
+        }
+    }
+    free(fill);
+
+    // depth[x]: 0 unvisited, INT32_MAX once its component is done, else the lowest stack depth reached
+    int *depth = (int *)calloc(count, sizeof(int));
+    int *next_edge = (int *)malloc(count * sizeof(int));
+    int *component = (int *)malloc(count * sizeof(int));   // Tarjan's stack
+    int *path = (int *)malloc(count * sizeof(int));        // Nodes being traversed, with their entry depth
+    int *entry_depth = (int *)malloc(count * sizeof(int));
+    int num_component = 0;
+
+    for (int root = 0; root < count; root++) {
+        if (depth[root] != 0) continue;
+
+        int num_path = 0;
+        component[num_component++] = root;
+        depth[root] = entry_depth[num_path] = num_component;
+        next_edge[root] = edge_start[root];
+        path[num_path++] = root;
+
+        while (num_path > 0) {
+            int x = path[num_path - 1];
+            SymbolSet *first_x = &first[num_terminals + x];
+
+            // traverse(y) for the next edge x R y, or F(x) |= F(y) if y was already visited
+            if (next_edge[x] < edge_start[x + 1]) {
+                int y = edges[next_edge[x]++];
+                if (depth[y] == 0) {
+                    component[num_component++] = y;
+                    depth[y] = entry_depth[num_path] = num_component;
+                    next_edge[y] = edge_start[y];
+                    path[num_path++] = y;
+                    continue;
                 }
+                if (depth[y] < depth[x]) depth[x] = depth[y];
+                set_union(first_x, &first[num_terminals + y]);
+                continue;
+            }
+
+            // Every edge of x is done: if x is the root of its component, pop the component
+            // and give all of it F(x)
+            if (depth[x] == entry_depth[num_path - 1]) {
+                int y;
+                do {
+                    y = component[--num_component];
+                    depth[y] = INT32_MAX;
+                    first[num_terminals + y] = *first_x;
+                } while (y != x);
+            }
+
+            // Back in the caller p: depth[p] = min(depth[p], depth[x]), F(p) |= F(x)
+            num_path--;
+            if (num_path > 0) {
+                int p = path[num_path - 1];
+                if (depth[x] < depth[p]) depth[p] = depth[x];
+                set_union(&first[num_terminals + p], first_x);
             }
         }
     }
+
+    free(edge_start);
+    free(depth);
+    free(next_edge);
+    free(component);
+    free(path);
+    free(entry_depth);
+    free(edges);
 }
 
-// Print an LR(1) item
-void print_item(LR1Item item) {
-    Rule rule = grammar[item.rule_index];
-    printf("[%c -> ", rule.lhs);
-    
-    for (int i = 0; i < rule.length; i++) {
-        if (i == item.dot_position) printf(".");
-        printf("%c", rule.rhs[i]);
+// Calculate FIRST sets for every symbol
+void compute_first_sets(FirstSets *first_sets) {
+    first_sets->first = (SymbolSet *)calloc(num_symbols, sizeof(SymbolSet));
+    first_sets->nullable = (bool *)calloc(num_symbols, sizeof(bool));
+    compute_nullable(first_sets->nullable);
+
+    // Initialize: FIRST(a) = {a} for all terminals a
+    for (int a = 0; a < num_terminals; a++) {
+        set_add(&first_sets->first[a], a);
     }
-    
-    if (item.dot_position == rule.length) printf(".");
-    printf(", %c]", item.lookahead);
+    digraph_first(first_sets->first, first_sets->nullable);
+
+    compute_suffix_first(first_sets);
+    compute_closure_templates(first_sets);
 }
 
-// Print an LR(1) state
-void print_state(LR1State state, int state_num) {
-    printf("State %d:\n", state_num);
-    for (int i = 0; i < state.num_items; i++) {
-        printf("  ");
-        print_item(state.items[i]);
-        printf("\n");
-    }
+// Release the storage of the FIRST sets
+void free_first_sets(FirstSets *first_sets) {
+    free(first_sets->first);
+    free(first_sets->nullable);
+    free(first_sets->suffix_start);
+    free(first_sets->suffix_first);
+    free(first_sets->suffix_nullable);
+    free(first_sets->rule_start);
+    free(first_sets->rules_of);
+    free(first_sets->template_start);
+    free(first_sets->templates);
 }
 
-// Print the LR(1) table
-void print_table(LR1Table *table, int num_states) {
-    printf("\nACTION TABLE:\n");
-    
-    // Header with all terminals
-    printf("State\t");
-    for (int t = 0; t < num_terminals; t++) {
-        printf("%c\t", terminals[t]);
+// Check if two LR(1) items have the same core and the same lookaheads
+bool items_equal(const LR1Item *item1, const LR1Item *item2) {
+    return item1->rule_index == item2->rule_index &&
+           item1->dot_position == item2->dot_position &&
+           set_equal(&item1->lookaheads, &item2->lookaheads);
+}
+
+// Calculate the closure of a set of LR(1) items. Each core appears once with all of its
+// lookaheads. The lookaheads every item passes to the non-terminal B after its dot are merged
+// per B first, then the template of each such B is instantiated once: no fixpoint is needed.
+// The input items are kernel items, whose lookaheads no template can grow ([S' -> .S] included).
+void closure(ItemSet *set, FirstSets *first_sets) {
+    static Array<int> slot_of_rule;     // Position of [rule -> .y] in the set, -1 between calls
+    static Array<SymbolSet> incoming;   // Lookaheads passed to each non-terminal
+    static Array<uint8_t> reached;      // 0: not after a dot, 1: only after LR(0) items, 2: after LR(1) items
+    static Array<Symbol> order;         // Reached non-terminals, in order of first appearance
+    if (slot_of_rule.size != grammar.size) {
+        array_resize(&slot_of_rule, grammar.size);
+        memset(slot_of_rule.data, -1, grammar.size * sizeof(int));
+    }
+    if (reached.size != num_non_terminals) {
+        array_resize(&incoming, num_non_terminals);
+        array_resize(&reached, num_non_terminals);
+        memset(reached.data, 0, num_non_terminals);
+    }
+
+    // Lookaheads of the B items: FIRST(beta), plus the item's own lookaheads if beta can vanish;
+    // an LR(0) item (empty lookahead set) only adds LR(0) items
+    order.size = 0;
+    int num_input = set->items.size;
+    for (int i = 0; i < num_input; i++) {
+        LR1Item *item = &set->items[i];
+        Rule *rule = &grammar[item->rule_index];
+        int dot = item->dot_position;
+        if (dot == 0) slot_of_rule[item->rule_index] = i;
+
+        // Check if the dot is before a non-terminal
+        if (dot == rule->length || is_terminal(rule->rhs[dot])) continue;
+        int B = rule->rhs[dot] - num_terminals;
+        if (reached[B] == 0) {
+            memset(&incoming[B], 0, sizeof(SymbolSet));
+            reached[B] = 1;
+            array_push(&order, (Symbol)B);
+        }
+        if (set_next(&item->lookaheads, 0) < 0) continue;
+
+        reached[B] = 2;
+        set_union(&incoming[B], suffix_first(first_sets, item->rule_index, dot + 1));
+        if (suffix_nullable(first_sets, item->rule_index, dot + 1)) {
+            set_union(&incoming[B], &item->lookaheads);
+        }
+    }
+
+    // For each template entry C of each reached B, add [C -> .d, spontaneous + incoming] to the
+    // closure or grow its lookaheads
+    for (int o = 0; o < order.size; o++) {
+        int B = order[o];
+        bool lr1 = reached[B] == 2;
+        for (int e = first_sets->template_start[B]; e < first_sets->template_start[B + 1]; e++) {
+            const TemplateEntry *entry = &first_sets->templates[e];
+            SymbolSet lookaheads = {{0}};
+            if (lr1) {
+                lookaheads = entry->spontaneous;
+                if (entry->inherits) set_union(&lookaheads, &incoming[B]);
+            }
+
+            int C = entry->non_terminal - num_terminals;
+            for (int r = first_sets->rule_start[C]; r < first_sets->rule_start[C + 1]; r++) {
+                int j = first_sets->rules_of[r];
+                if (slot_of_rule[j] == -1) {
+                    LR1Item new_item = {(uint32_t)j, 0, lookaheads};
+                    slot_of_rule[j] = set->items.size;
+                    array_push(&set->items, new_item);
+                } else {
+                    set_union(&set->items[slot_of_rule[j]].lookaheads, &lookaheads);
+                }
+            }
+        }
+        reached[B] = 0;
+    }
+
+    for (int i = 0; i < set->items.size; i++) {
+        if (set->items[i].dot_position == 0) slot_of_rule[set->items[i].rule_index] = -1;
+    }
+}
+
+// Sort key of an item: rule, then dot position
+static inline uint64_t item_key(const LR1Item *item) {
+    return (uint64_t)item->rule_index << 8 | item->dot_position;
+}
+
+// Fold an item key into 32 bits for FNV-1a
+static inline uint32_t item_key_word(const LR1Item *item) {
+    uint64_t key = item_key(item);
+    return (uint32_t)(key ^ key >> 32);
+}
+
+int compare_items(const void *a, const void *b) {
+    uint64_t ka = item_key((const LR1Item *)a);
+    uint64_t kb = item_key((const LR1Item *)b);
+    return (ka > kb) - (ka < kb);
+}
+
+// FNV-1a over the cores and lookahead words of an item array
+uint32_t hash_items(const LR1Item *items, int num_items) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < num_items; i++) {
+        hash = (hash ^ item_key_word(&items[i])) * 16777619u;
+        for (int w = 0; w < SET_WORDS; w++) {
+            BitWord word = items[i].lookaheads.words[w];
+            hash = (hash ^ (uint32_t)(word ^ word >> 32)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Put an item set in canonical form: items sorted by core and hashed
+void canonicalize_set(ItemSet *set) {
+    qsort(set->items.data, set->items.size, sizeof(LR1Item), compare_items);
+    set->hash = hash_items(set->items.data, set->items.size);
+}
+
+// Items of a state of the collection (valid until the item pool grows)
+static inline LR1Item *state_items(LR1Automaton *automaton, int state) {
+    return &automaton->items[automaton->states[state].first_item];
+}
+
+// Check if a state holds exactly the items of a canonical set
+bool state_equals_set(LR1Automaton *automaton, int state, const ItemSet *set) {
+    LR1State *s = &automaton->states[state];
+    if (s->hash != set->hash || s->num_items != set->items.size) return false;
+
+    const LR1Item *items = state_items(automaton, state);
+    for (int i = 0; i < s->num_items; i++) {
+        if (!items_equal(&items[i], &set->items[i])) return false;
+    }
+    return true;
+}
+
+// Find the slot holding a state equal to a canonical set, or the empty slot where it belongs
+int probe_state(LR1Automaton *automaton, const ItemSet *set) {
+    int mask = automaton->index.size - 1;
+    int slot = set->hash & mask;
+    while (automaton->index[slot] != -1 && !state_equals_set(automaton, automaton->index[slot], set)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Rebuild the intern table, with room for twice the current number of states
+void reindex_states(LR1Automaton *automaton) {
+    int buckets = 64;
+    while (buckets < 2 * automaton->states.size + 2) buckets *= 2;
+    array_resize(&automaton->index, buckets);
+    memset(automaton->index.data, -1, buckets * sizeof(int));
+
+    for (int i = 0; i < automaton->states.size; i++) {
+        LR1State *s = &automaton->states[i];
+        int slot = s->hash & (buckets - 1);
+        while (automaton->index[slot] != -1) slot = (slot + 1) & (buckets - 1);
+        automaton->index[slot] = i;
+    }
+}
+
+// Point a state at a copy of a canonical set appended to the item pool
+void set_state_items(LR1Automaton *automaton, int state, const ItemSet *set) {
+    LR1State *s = &automaton->states[state];
+    s->first_item = automaton->items.size;
+    s->num_items = set->items.size;
+    s->hash = set->hash;
+
+    array_reserve(&automaton->items, automaton->items.size + set->items.size);
+    memcpy(&automaton->items[automaton->items.size], set->items.data, set->items.size * sizeof(LR1Item));
+    automaton->items.size += set->items.size;
+}
+
+// Add a canonical set to the collection unless already present, return its state index
+int intern_state(LR1Automaton *automaton, const ItemSet *set) {
+    int slot = probe_state(automaton, set);
+    if (automaton->index[slot] != -1) return automaton->index[slot];
+
+    int state = automaton->states.size;
+    LR1State empty = {0, 0, 0};
+    array_push(&automaton->states, empty);
+    set_state_items(automaton, state, set);
+    automaton->index[slot] = state;
+
+    // Keep the load factor under one half
+    if (2 * automaton->states.size > automaton->index.size) reindex_states(automaton);
+    return state;
+}
+
+// Record the edge from --symbol--> to
+void add_transition(LR1Automaton *automaton, int from, Symbol symbol, int to) {
+    Transition edge = {from, symbol, to};
+    array_push(&automaton->transitions, edge);
+}
+
+// Successor kernels of a state, see successor_kernels
+typedef struct {
+    Array<Symbol> symbols;     // Symbol of kernel b
+    Array<LR1Item> items;      // Items of every kernel, kernel b is a contiguous slice
+    Array<int> start;          // Kernel b: items [start[b], start[b + 1])
+} Successors;
+
+// Calculate the kernel of every non-empty GOTO(I, X) in one pass over the items of I
+void successor_kernels(const LR1Item *items, int num_items, Successors *successors) {
+    static Array<int> item_bucket;
+    static Array<int> fill;
+    static Array<int> bucket_of;  // Bucket of each symbol, -1 between calls
+    if (bucket_of.size != num_symbols) {
+        array_resize(&bucket_of, num_symbols);
+        memset(bucket_of.data, -1, num_symbols * sizeof(int));
+    }
+    array_resize(&item_bucket, num_items);
+
+    // Bucket the items by the symbol after the dot, in order of first appearance;
+    // start[b + 1] counts the items of bucket b for now
+    successors->symbols.size = 0;
+    array_resize(&successors->start, 1);
+    successors->start[0] = 0;
+    for (int j = 0; j < num_items; j++) {
+        Rule *rule = &grammar[items[j].rule_index];
+        item_bucket[j] = -1;
+        if (items[j].dot_position == rule->length) continue;
+
+        Symbol X = rule->rhs[items[j].dot_position];
+        if (bucket_of[X] == -1) {
+            bucket_of[X] = successors->symbols.size;
+            array_push(&successors->symbols, X);
+            array_push(&successors->start, 0);
+        }
+        item_bucket[j] = bucket_of[X];
+        successors->start[item_bucket[j] + 1]++;
+    }
+
+    // Scatter the advanced items so that each kernel is a contiguous slice
+    int num_buckets = successors->symbols.size;
+    for (int b = 0; b < num_buckets; b++) {
+        successors->start[b + 1] += successors->start[b];
+    }
+    array_resize(&successors->items, successors->start[num_buckets]);
+    array_resize(&fill, num_buckets);
+    memcpy(fill.data, successors->start.data, num_buckets * sizeof(int));
+    for (int j = 0; j < num_items; j++) {
+        if (item_bucket[j] == -1) continue;
+        LR1Item item = items[j];
+        item.dot_position++;
+        successors->items[fill[item_bucket[j]]++] = item;
+    }
+    for (int b = 0; b < num_buckets; b++) bucket_of[successors->symbols[b]] = -1;
+}
+
+// Copy kernel b of a successor list into an item set
+void load_kernel(const Successors *successors, int b, ItemSet *set) {
+    int count = successors->start[b + 1] - successors->start[b];
+    array_resize(&set->items, count);
+    memcpy(set->items.data, &successors->items[successors->start[b]], count * sizeof(LR1Item));
+}
+
+// Calculate every non-empty GOTO(I, X) of a state, interning the successors and recording the edges
+void expand_state(LR1Automaton *automaton, int i, FirstSets *first_sets) {
+    static Successors successors;
+    static ItemSet new_state;
+    successor_kernels(state_items(automaton, i), automaton->states[i].num_items, &successors);
+
+    // Close each kernel into a state
+    for (int b = 0; b < successors.symbols.size; b++) {
+        load_kernel(&successors, b, &new_state);
+        closure(&new_state, first_sets);
+        canonicalize_set(&new_state);
+
+        int target = intern_state(automaton, &new_state);
+        add_transition(automaton, i, successors.symbols[b], target);
+    }
+}
+
+// Empty the collection, keeping its storage
+void reset_automaton(LR1Automaton *automaton) {
+    automaton->states.size = 0;
+    automaton->items.size = 0;
+    automaton->transitions.size = 0;
+    automaton->transition_start.size = 0;
+    reindex_states(automaton);
+}
+
+// Release the storage of a collection
+void free_automaton(LR1Automaton *automaton) {
+    array_free(&automaton->states);
+    array_free(&automaton->items);
+    array_free(&automaton->index);
+    array_free(&automaton->transitions);
+    array_free(&automaton->transition_start);
+}
+
+// Build the canonical collection of LR(1) states and its GOTO graph.
+// Starting from [S' -> .S] with NO_LOOKAHEAD builds the LR(0) collection instead.
+void build_lr1_states(LR1Automaton *automaton, int start_lookahead, FirstSets *first_sets) {
+    reset_automaton(automaton);
+
+    // Ensure grammar[0] is the augmented rule S' -> OriginalStartSymbol
+    if (grammar.size == 0) {
+        printf("Error: Cannot build states, grammar is empty or not augmented.\n");
+        return;
+    }
+
+    // Initial state with [S' -> .S, $] (assuming grammar[0] is S' -> S)
+    ItemSet initial_state = {{NULL, 0, 0}, 0};
+    LR1Item initial_item = {0, 0, {{0}}}; // Rule 0, dot at start, lookahead $
+    if (start_lookahead != NO_LOOKAHEAD) set_add(&initial_item.lookaheads, start_lookahead);
+    array_push(&initial_state.items, initial_item);
+
+    // Calculate the closure of the initial state
+    closure(&initial_state, first_sets);
+    canonicalize_set(&initial_state);
+    intern_state(automaton, &initial_state);
+    array_free(&initial_state.items);
+
+    // Build other states; states are expanded in order, so their edges come out grouped
+    for (int i = 0; i < automaton->states.size; i++) {
+        array_push(&automaton->transition_start, automaton->transitions.size);
+        expand_state(automaton, i, first_sets);
+    }
+    array_push(&automaton->transition_start, automaton->transitions.size);
+}
+
+// Position of the item with a given core in a canonical item array, or -1
+int find_item(const LR1Item *items, int num_items, int rule_index, int dot_position) {
+    uint64_t key = (uint64_t)rule_index << 8 | dot_position;
+    int lo = 0, hi = num_items - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint64_t mid_key = item_key(&items[mid]);
+        if (mid_key == key) return mid;
+        if (mid_key < key) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
+
+// Kernel items are the ones closure did not add: dot moved, or the start item
+static inline bool is_kernel_item(const LR1Item *item) {
+    return item->dot_position > 0 || item->rule_index == 0;
+}
+
+// Build the LALR(1) collection: LR(0) states whose kernel lookaheads are found by the
+// spontaneous/propagated method, then closed into LR(1) items for build_lr1_table
+void build_lalr1_states(LR1Automaton *automaton, FirstSets *first_sets) {
+    build_lr1_states(automaton, NO_LOOKAHEAD, first_sets);
+    int num_states = automaton->states.size;
+
+    // The empty lookahead sets of the LR(0) kernel items collect their LALR(1) lookaheads;
+    // propagation links between kernel items are (from, to) pool positions
+    Array<int> links = {NULL, 0, 0};
+
+    // [S' -> .S] gets $ spontaneously
+    set_add(&state_items(automaton, 0)[find_item(state_items(automaton, 0), automaton->states[0].num_items, 0, 0)].lookaheads,
+            END_SYMBOL);
+
+    int *target_of = (int *)malloc(num_symbols * sizeof(int));
+    ItemSet probe = {{NULL, 0, 0}, 0};
+    for (int i = 0; i < num_states; i++) {
+        for (int e = automaton->transition_start[i]; e < automaton->transition_start[i + 1]; e++) {
+            target_of[automaton->transitions[e].symbol] = automaton->transitions[e].to;
+        }
+
+        for (int k = 0; k < automaton->states[i].num_items; k++) {
+            LR1Item kernel = state_items(automaton, i)[k];
+            if (!is_kernel_item(&kernel)) continue;
+
+            // closure({[kernel, #]}): # comes back where the kernel's lookaheads propagate
+            memset(&kernel.lookaheads, 0, sizeof(SymbolSet));
+            set_add(&kernel.lookaheads, PROPAGATE_LOOKAHEAD);
+            probe.items.size = 0;
+            array_push(&probe.items, kernel);
+            closure(&probe, first_sets);
+
+            for (int j = 0; j < probe.items.size; j++) {
+                LR1Item *item = &probe.items[j];
+                Rule *rule = &grammar[item->rule_index];
+                if (item->dot_position == rule->length) continue;
+
+                int t = target_of[rule->rhs[item->dot_position]];
+                int to = automaton->states[t].first_item +
+                         find_item(state_items(automaton, t), automaton->states[t].num_items,
+                                   item->rule_index, item->dot_position + 1);
+                if (set_contains(&item->lookaheads, PROPAGATE_LOOKAHEAD)) {
+                    set_remove(&item->lookaheads, PROPAGATE_LOOKAHEAD);
+                    array_push(&links, automaton->states[i].first_item + k);
+                    array_push(&links, to);
+                }
+                set_union(&automaton->items[to].lookaheads, &item->lookaheads);
+            }
+        }
+    }
+
+    // Propagate until no set grows
+    bool changed;
+    do {
+        changed = false;
+        for (int l = 0; l < links.size; l += 2) {
+            if (set_union(&automaton->items[links[l + 1]].lookaheads, &automaton->items[links[l]].lookaheads)) {
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    // Re-close every kernel with its lookaheads so that reductions show up as LR(1) items
+    Array<LR1Item> lr0_items = automaton->items;
+    Array<LR1Item> empty_pool = {NULL, 0, 0};
+    automaton->items = empty_pool;
+    ItemSet lalr_state = {{NULL, 0, 0}, 0};
+    for (int i = 0; i < num_states; i++) {
+        LR1State *state = &automaton->states[i];
+        lalr_state.items.size = 0;
+        for (int k = state->first_item; k < state->first_item + state->num_items; k++) {
+            if (is_kernel_item(&lr0_items[k])) array_push(&lalr_state.items, lr0_items[k]);
+        }
+        closure(&lalr_state, first_sets);
+        canonicalize_set(&lalr_state);
+        set_state_items(automaton, i, &lalr_state);
+    }
+
+    // The states changed, index them again
+    reindex_states(automaton);
+
+    free(target_of);
+    array_free(&links);
+    array_free(&lr0_items);
+    array_free(&probe.items);
+    array_free(&lalr_state.items);
+}
+
+// Kernel of a state: its kernel items in state order
+typedef struct {
+    Array<LR1Item> items;
+    uint32_t core_hash;  // Hash of the cores only, equal for states Pager may merge
+} Kernel;
+
+// Check if two sets share a symbol
+static inline bool set_intersects(const SymbolSet *a, const SymbolSet *b) {
+    for (int w = 0; w < SET_WORDS; w++) {
+        if (a->words[w] & b->words[w]) return true;
+    }
+    return false;
+}
+
+// Collect the kernel items of a canonical item array
+void get_kernel(const LR1Item *items, int num_items, Kernel *kernel) {
+    kernel->items.size = 0;
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < num_items; i++) {
+        if (!is_kernel_item(&items[i])) continue;
+        array_push(&kernel->items, items[i]);
+        hash = (hash ^ item_key_word(&items[i])) * 16777619u;
+    }
+    kernel->core_hash = hash;
+}
+
+// Check if two kernels have the same LR(0) core
+bool same_core(const Kernel *a, const Kernel *b) {
+    if (a->core_hash != b->core_hash || a->items.size != b->items.size) return false;
+    for (int i = 0; i < a->items.size; i++) {
+        if (item_key(&a->items[i]) != item_key(&b->items[i])) return false;
+    }
+    return true;
+}
+
+// Pager's weak compatibility: merging cannot create a conflict that neither kernel
+// already has, i.e. for every pair i != j, a lookahead shared across the two kernels
+// is only allowed if one of them already shares a lookahead between i and j
+bool weakly_compatible(const Kernel *a, const Kernel *b) {
+    for (int i = 0; i < a->items.size; i++) {
+        const SymbolSet *ai = &a->items[i].lookaheads, *bi = &b->items[i].lookaheads;
+        for (int j = i + 1; j < a->items.size; j++) {
+            const SymbolSet *aj = &a->items[j].lookaheads, *bj = &b->items[j].lookaheads;
+            if (!set_intersects(ai, bj) && !set_intersects(bi, aj)) continue;
+            if (set_intersects(ai, aj) || set_intersects(bi, bj)) continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Close a kernel into a canonical item set
+void close_kernel(const Kernel *kernel, ItemSet *set, FirstSets *first_sets) {
+    array_resize(&set->items, kernel->items.size);
+    memcpy(set->items.data, kernel->items.data, kernel->items.size * sizeof(LR1Item));
+    closure(set, first_sets);
+    canonicalize_set(set);
+}
+
+// Working state of the Pager construction
+typedef struct {
+    Array<int> core_head;       // Chains of states sharing a core hash, size a power of two
+    Array<int> core_next;
+    Array<uint32_t> core_hash;  // Core hash of every state
+    Array<int> successor;       // GOTO edges, num_symbols per state, -1 when absent
+    Array<int> queue;           // States whose successors must be (re)computed, from queue_head on
+    Array<bool> queued;
+    int queue_head;
+} PagerWork;
+
+// Queue a state for expansion unless it is already waiting
+void pager_enqueue(PagerWork *work, int state) {
+    if (work->queued[state]) return;
+    work->queued[state] = true;
+    array_push(&work->queue, state);
+}
+
+// Rebuild the core chains with room for twice the current number of states
+void pager_rehash(PagerWork *work) {
+    int buckets = 64;
+    while (buckets < 2 * work->core_next.size + 2) buckets *= 2;
+    array_resize(&work->core_head, buckets);
+    memset(work->core_head.data, -1, buckets * sizeof(int));
+    for (int c = 0; c < work->core_next.size; c++) {
+        int bucket = work->core_hash[c] & (buckets - 1);
+        work->core_next[c] = work->core_head[bucket];
+        work->core_head[bucket] = c;
+    }
+}
+
+// Find a state a successor kernel can go to: an equal or weakly compatible state with
+// the same core (merged into, and queued again if its lookaheads grew), or a new state
+int pager_intern(LR1Automaton *automaton, PagerWork *work, Kernel *kernel, FirstSets *first_sets) {
+    static Kernel existing;
+    static ItemSet merged;
+    int bucket = kernel->core_hash & (work->core_head.size - 1);
+
+    for (int c = work->core_head[bucket]; c != -1; c = work->core_next[c]) {
+        if (work->core_hash[c] != kernel->core_hash) continue;
+        get_kernel(state_items(automaton, c), automaton->states[c].num_items, &existing);
+        if (!same_core(kernel, &existing) || !weakly_compatible(kernel, &existing)) continue;
+
+        bool grew = false;
+        for (int i = 0; i < existing.items.size; i++) {
+            if (set_union(&existing.items[i].lookaheads, &kernel->items[i].lookaheads)) grew = true;
+        }
+        if (grew) {
+            // The old slice is left behind in the pool, build_pager_states compacts it
+            close_kernel(&existing, &merged, first_sets);
+            set_state_items(automaton, c, &merged);
+            pager_enqueue(work, c);
+        }
+        return c;
+    }
+
+    int n = automaton->states.size;
+    LR1State empty = {0, 0, 0};
+    array_push(&automaton->states, empty);
+    close_kernel(kernel, &merged, first_sets);
+    set_state_items(automaton, n, &merged);
+
+    array_push(&work->core_hash, kernel->core_hash);
+    array_push(&work->core_next, work->core_head[bucket]);
+    work->core_head[bucket] = n;
+    if (2 * work->core_next.size > work->core_head.size) pager_rehash(work);
+
+    array_resize(&work->successor, (n + 1) * num_symbols);
+    memset(&work->successor[n * num_symbols], -1, num_symbols * sizeof(int));
+    array_push(&work->queued, false);
+    pager_enqueue(work, n);
+    return n;
+}
+
+// Build a minimal LR(1) collection: canonical LR(1) construction where a new state is
+// merged on the fly into a weakly compatible state with the same core (Pager 1977)
+void build_pager_states(LR1Automaton *automaton, FirstSets *first_sets) {
+    PagerWork work = {};
+    Kernel kernel = {};
+    Successors successors = {};
+    ItemSet kernel_set = {};
+    reset_automaton(automaton);
+    pager_rehash(&work);
+    work.queue_head = 0;
+
+    if (grammar.size == 0) {
+        printf("Error: Cannot build states, grammar is empty or not augmented.\n");
+        return;
+    }
+    LR1Item start = {0, 0, {{0}}};
+    set_add(&start.lookaheads, END_SYMBOL);
+    get_kernel(&start, 1, &kernel);
+    pager_intern(automaton, &work, &kernel, first_sets);
+
+    // Expand until no state is waiting; a merged state is expanded again with its new lookaheads
+    while (work.queue_head < work.queue.size) {
+        int i = work.queue[work.queue_head++];
+        work.queued[i] = false;
+
+        successor_kernels(state_items(automaton, i), automaton->states[i].num_items, &successors);
+        for (int b = 0; b < successors.symbols.size; b++) {
+            load_kernel(&successors, b, &kernel_set);
+            canonicalize_set(&kernel_set);
+            get_kernel(kernel_set.items.data, kernel_set.items.size, &kernel);
+            int target = pager_intern(automaton, &work, &kernel, first_sets);
+            work.successor[i * num_symbols + successors.symbols[b]] = target;
+        }
+    }
+
+    // Merges can leave states that no edge reaches any more; keep the reachable ones in BFS order
+    int num_states = automaton->states.size;
+    int *new_index = (int *)malloc(num_states * sizeof(int));
+    int *order = (int *)malloc(num_states * sizeof(int));
+    memset(new_index, -1, num_states * sizeof(int));
+    int num_reachable = 0;
+    new_index[0] = 0;
+    order[num_reachable++] = 0;
+    for (int o = 0; o < num_reachable; o++) {
+        for (int X = 0; X < num_symbols; X++) {
+            int target = work.successor[order[o] * num_symbols + X];
+            if (target != -1 && new_index[target] == -1) {
+                new_index[target] = num_reachable;
+                order[num_reachable++] = target;
+            }
+        }
+    }
+
+    // Copy the reachable states into a fresh, compact item pool
+    Array<LR1State> old_states = automaton->states;
+    Array<LR1Item> old_items = automaton->items;
+    Array<LR1State> no_states = {NULL, 0, 0};
+    Array<LR1Item> no_items = {NULL, 0, 0};
+    automaton->states = no_states;
+    automaton->items = no_items;
+    for (int o = 0; o < num_reachable; o++) {
+        LR1State state = old_states[order[o]];
+        kernel_set.items.size = 0;
+        for (int k = 0; k < state.num_items; k++) array_push(&kernel_set.items, old_items[state.first_item + k]);
+        kernel_set.hash = state.hash;
+        array_push(&automaton->states, state);
+        set_state_items(automaton, o, &kernel_set);
+    }
+
+    automaton->transitions.size = 0;
+    automaton->transition_start.size = 0;
+    for (int o = 0; o < num_reachable; o++) {
+        array_push(&automaton->transition_start, automaton->transitions.size);
+        for (int X = 0; X < num_symbols; X++) {
+            int target = work.successor[order[o] * num_symbols + X];
+            if (target != -1) add_transition(automaton, o, (Symbol)X, new_index[target]);
+        }
+    }
+    array_push(&automaton->transition_start, automaton->transitions.size);
+    reindex_states(automaton);
+
+    free(new_index);
+    free(order);
+    array_free(&old_states);
+    array_free(&old_items);
+    array_free(&work.core_head);
+    array_free(&work.core_next);
+    array_free(&work.core_hash);
+    array_free(&work.successor);
+    array_free(&work.queue);
+    array_free(&work.queued);
+    array_free(&kernel.items);
+    array_free(&successors.symbols);
+    array_free(&successors.items);
+    array_free(&successors.start);
+    array_free(&kernel_set.items);
+}
+
+// Error entry written by %nonassoc: non-zero so that default reductions leave it alone
+#define EXPLICIT_ERROR make_action(ACTION_ERROR, 1)
+
+// Write an ACTION entry as text ("s12", "r3", "acc", "sr3" for shift-reduce, "err" for an explicit error),
+// buffer of at least 16 chars
+const char *format_action(Action action, char *buffer) {
+    switch (action_type(action)) {
+        case ACTION_SHIFT:  sprintf(buffer, "s%d", action_value(action)); break;
+        case ACTION_REDUCE: sprintf(buffer, "r%d", action_value(action)); break;
+        case ACTION_ACCEPT: strcpy(buffer, "acc"); break;
+        case ACTION_SHIFT_REDUCE: sprintf(buffer, "sr%d", action_value(action)); break;
+        default:            strcpy(buffer, action == EXPLICIT_ERROR ? "err" : ""); break;
+    }
+    return buffer;
+}
+
+// Settle a shift/reduce conflict on terminal a with the declared precedences, yacc style:
+// the rule wins if it binds tighter, the shift if a does, and on a tie the associativity of a
+// decides. Returns false, leaving the shift in place, when either precedence is undeclared.
+bool resolve_by_precedence(Action *entry, int a, int rule_index) {
+    int rule_level = rule_precedence(&grammar[rule_index]);
+    Precedence token = symbol_precedence[a];
+    if (rule_level == 0 || token.level == 0) return false;
+
+    if (rule_level > token.level || (rule_level == token.level && token.assoc == ASSOC_LEFT)) {
+        *entry = make_action(ACTION_REDUCE, rule_index);
+    } else if (rule_level == token.level && token.assoc == ASSOC_NONASSOC) {
+        *entry = EXPLICIT_ERROR;
+    }
+    return true;
+}
+
+// Reduction of a consistent state: one rule reduced on every lookahead that is not an error,
+// no shift, accept or %nonassoc error. ACTION_ERROR (0) if the state is not consistent.
+// Reducing there before reading the lookahead only delays the detection of an error.
+Action consistent_reduction(const LR1Table *table, int state) {
+    const Action *row = &table->action[state * num_terminals];
+    Action reduction = 0;
+    for (int t = 0; t < num_terminals; t++) {
+        if (row[t] == 0) continue;
+        if (action_type(row[t]) != ACTION_REDUCE || (reduction != 0 && row[t] != reduction)) return 0;
+        reduction = row[t];
+    }
+    return reduction;
+}
+
+// Build the LR(1) parsing table from the recorded automaton; quiet drops the conflict reports
+void build_lr1_table(LR1Automaton *automaton, LR1Table *table, bool quiet) {
+    int num_states = automaton->states.size;
+
+    // Initialize tables, one row per state
+    table->num_states = num_states;
+    table->mapping = NULL;
+    table->mapping_size = 0;
+    table->action = (Action *)calloc((size_t)num_states * num_terminals, sizeof(Action));
+    table->goto_table = (int32_t *)malloc((size_t)num_states * num_non_terminals * sizeof(int32_t));
+    table->rule_length = (int *)malloc(grammar.size * sizeof(int));
+    table->rule_lhs = (Symbol *)malloc(grammar.size * sizeof(Symbol));
+    table->consistent = (Action *)malloc(num_states * sizeof(Action));
+    if (table->action == NULL || table->goto_table == NULL || table->rule_length == NULL || table->rule_lhs == NULL ||
+        table->consistent == NULL) {
+        printf("Error: out of memory while building the table\n");
+        exit(1);
+    }
+    memset(table->goto_table, -1, (size_t)num_states * num_non_terminals * sizeof(int32_t));
+    for (int r = 0; r < grammar.size; r++) {
+        table->rule_length[r] = grammar[r].length;
+        table->rule_lhs[r] = grammar[r].lhs;
+    }
+    
+    // First, every edge becomes a shift (terminal) or a GOTO entry (non-terminal)
+    for (int e = 0; e < automaton->transitions.size; e++) {
+        Transition edge = automaton->transitions[e];
+        if (is_terminal(edge.symbol)) {
+            table->action[edge.from * num_terminals + edge.symbol] = make_action(ACTION_SHIFT, edge.to);
+        } else {
+            table->goto_table[edge.from * num_non_terminals + edge.symbol - num_terminals] = edge.to;
+        }
+    }
+    
+    // Then fill the ACTION table
+    char text[16];
+    int resolved = 0;  // Shift/reduce conflicts settled by precedence
+    for (int i = 0; i < num_states; i++) {
+        Action *row = &table->action[i * num_terminals];
+
+        // For each item in state i
+        const LR1Item *items = state_items(automaton, i);
+        for (int j = 0; j < automaton->states[i].num_items; j++) {
+            LR1Item item = items[j];
+            Rule rule = grammar[item.rule_index];
+            
+            if (item.dot_position < rule.length) {
+                // [A -> α.Xb, a]: the shift or GOTO on X was filled from the edges above
+                continue;
+            }
+
+            // [A -> b., a], the dot is at the end, add a reduce action for every lookahead a
+            for (int a = set_next(&item.lookaheads, 0); a >= 0; a = set_next(&item.lookaheads, a + 1)) {
+                if (item.rule_index == 0 && a == END_SYMBOL) {
+                    // S' -> S., $ -> accept
+                    if (row[END_SYMBOL] != 0 && !quiet) {
+                        printf("Conflict in state %d for symbol $: %s vs acc\n", 
+                               i, format_action(row[END_SYMBOL], text));
+                    }
+                    // Accept should always take priority
+                    row[END_SYMBOL] = make_action(ACTION_ACCEPT, 0);
+                    continue;
+                }
+
+                // A -> b., a -> reduce by A -> b
+                Action existing = row[a];
+                switch (action_type(existing)) {
+                    case ACTION_ERROR:
+                        // An explicit error from %nonassoc stays
+                        if (existing == 0) row[a] = make_action(ACTION_REDUCE, item.rule_index);
+                        break;
+
+                    case ACTION_REDUCE:
+                        // Reduce-Reduce conflict
+                        if (!quiet) printf("Reduce-Reduce conflict in state %d for symbol %s: r%d vs r%d\n", 
+                               i, symbol_names[a], action_value(existing), item.rule_index);
+                    
+                        // Resolution by rule priority (choose rule with lower index)
+                        if ((int)item.rule_index < action_value(existing)) {
+                            row[a] = make_action(ACTION_REDUCE, item.rule_index);
+                        }
+                        break;
+
+                    case ACTION_SHIFT:
+                        // Shift-Reduce conflict, settled by %left/%right/%nonassoc when declared
+                        if (resolve_by_precedence(&row[a], a, item.rule_index)) {
+                            resolved++;
+                            break;
+                        }
+                        if (!quiet) printf("Shift-Reduce conflict in state %d for symbol %s: s%d vs r%d\n", 
+                               i, symbol_names[a], action_value(existing), item.rule_index);
+                    
+                        // By default, prefer shift (do nothing)
+                        break;
+                }
+            }
+        }
+    }
+    if (resolved > 0 && !quiet) {
+        printf("%d shift/reduce conflict%s resolved by precedence\n", resolved, resolved > 1 ? "s" : "");
+    }
+
+    // Finally mark the consistent states, the driver reduces there without the lookahead
+    for (int i = 0; i < num_states; i++) table->consistent[i] = consistent_reduction(table, i);
+}
+
+// Unit rule A -> B reduced by a state that does nothing else (consistent, no GOTO), or -1
+int unit_reduction(const LR1Table *table, int state) {
+    Action action = table->consistent[state];
+    if (action == 0) return -1;
+    int rule = action_value(action);
+    if (rule == 0 || table->rule_length[rule] != 1 || !is_non_terminal(grammar[rule].rhs[0])) return -1;
+    for (int n = 0; n < num_non_terminals; n++) {
+        if (table->goto_table[state * num_non_terminals + n] != -1) return -1;
+    }
+    return rule;
+}
+
+// Bypass the unit reductions: when GOTO[p, B] = q and q only reduces A -> B, the driver would
+// pop q right away and go to GOTO[p, A], so GOTO[p, B] can point there directly (following
+// chains such as F -> T -> E). The rules carry no semantic action, so no one misses the
+// skipped reductions; like any default reduction this only delays an error. Returns the
+// number of GOTO entries rewritten.
+int bypass_unit_reductions(LR1Table *table) {
+    int num_states = table->num_states;
+    int *unit = (int *)malloc(num_states * sizeof(int));
+    for (int i = 0; i < num_states; i++) unit[i] = unit_reduction(table, i);
+
+    int rewritten = 0;
+    for (int p = 0; p < num_states; p++) {
+        int32_t *row = &table->goto_table[p * num_non_terminals];
+        for (int n = 0; n < num_non_terminals; n++) {
+            int target = row[n], steps = 0;
+            while (target != -1 && unit[target] != -1 && steps < num_states) {
+                target = row[table->rule_lhs[unit[target]] - num_terminals];
+                steps++;
+            }
+            // A cycle of unit rules (A -> B, B -> A) is left alone
+            if (target == -1 || target == row[n] || steps == num_states) continue;
+            row[n] = target;
+            rewritten++;
+        }
+    }
+    free(unit);
+    return rewritten;
+}
+
+// Fuse the shifts into states that only reduce: when ACTION[p, t] shifts to q and q does nothing
+// but reduce A -> a t (consistent, no GOTO), the entry becomes "shift t and reduce A -> a t".
+// The driver then consumes t and pops |a| states without ever pushing q. Returns the number of
+// entries fused.
+int fuse_shift_reductions(LR1Table *table) {
+    int num_states = table->num_states;
+    bool *reduce_only = (bool *)malloc(num_states * sizeof(bool));
+    for (int i = 0; i < num_states; i++) {
+        reduce_only[i] = table->consistent[i] != 0;
+        for (int n = 0; reduce_only[i] && n < num_non_terminals; n++) {
+            if (table->goto_table[i * num_non_terminals + n] != -1) reduce_only[i] = false;
+        }
+    }
+
+    int fused = 0;
+    for (int e = 0; e < num_states * num_terminals; e++) {
+        Action action = table->action[e];
+        if (action_type(action) != ACTION_SHIFT || !reduce_only[action_value(action)]) continue;
+        table->action[e] = make_action(ACTION_SHIFT_REDUCE, action_value(table->consistent[action_value(action)]));
+        fused++;
+    }
+    free(reduce_only);
+    return fused;
+}
+
+// Mark the states the driver can enter from state 0 through shifts and GOTOs, return their number
+int mark_reachable_states(const LR1Table *table, bool *reachable) {
+    int num_states = table->num_states;
+    int *queue = (int *)malloc(num_states * sizeof(int));
+    memset(reachable, 0, num_states * sizeof(bool));
+    int count = 0;
+    reachable[0] = true;
+    queue[count++] = 0;
+    for (int head = 0; head < count; head++) {
+        int i = queue[head];
+        for (int t = 0; t < num_terminals; t++) {
+            Action action = table->action[i * num_terminals + t];
+            if (action_type(action) != ACTION_SHIFT || reachable[action_value(action)]) continue;
+            reachable[action_value(action)] = true;
+            queue[count++] = action_value(action);
+        }
+        for (int n = 0; n < num_non_terminals; n++) {
+            int target = table->goto_table[i * num_non_terminals + n];
+            if (target == -1 || reachable[target]) continue;
+            reachable[target] = true;
+            queue[count++] = target;
+        }
+    }
+    free(queue);
+    return count;
+}
+
+// Release the storage of a table
+void free_table(LR1Table *table) {
+    if (table->mapping != NULL) {
+        munmap(table->mapping, table->mapping_size);
+        return;
+    }
+    free(table->action);
+    free(table->goto_table);
+    free(table->rule_length);
+    free(table->rule_lhs);
+    free(table->consistent);
+}
+
+// Header of a table cache file. The file holds, at 8-byte aligned offsets: the normalized
+// grammar (build mode, symbol names, rules as IDs, precedences), ACTION, GOTO, rule lengths, rule LHS
+// and consistent reductions
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t grammar_hash;  // FNV-1a of the normalized grammar, also the file name
+    int32_t num_states;
+    int32_t num_terminals;
+    int32_t num_non_terminals;
+    int32_t num_rules;
+    uint64_t grammar_offset, grammar_size;
+    uint64_t action_offset, goto_offset, rule_length_offset, rule_lhs_offset, consistent_offset;
+    uint64_t file_size;
+} CacheHeader;
+
+// Append bytes to a buffer
+void append_bytes(Array<char> *buffer, const void *bytes, int size) {
+    array_reserve(buffer, buffer->size + size);
+    memcpy(&buffer->data[buffer->size], bytes, size);
+    buffer->size += size;
+}
+
+// Serialize the grammar as numbered by finalize_symbols, with the build mode and the table
+// post-passes: two runs may share a table exactly when these bytes are equal
+void normalize_grammar(BuildMode mode, bool skip_units, bool fuse, Array<char> *buffer) {
+    buffer->size = 0;
+    int32_t header[6] = {(int32_t)mode, skip_units, fuse, num_terminals, num_non_terminals, grammar.size};
+    append_bytes(buffer, header, sizeof(header));
+    for (int id = 0; id < num_symbols; id++) {
+        append_bytes(buffer, symbol_names[id], strlen(symbol_names[id]) + 1);
+    }
+    for (int r = 0; r < grammar.size; r++) {
+        Symbol rule_header[3] = {grammar[r].lhs, (Symbol)grammar[r].length, grammar[r].prec};
+        append_bytes(buffer, rule_header, sizeof(rule_header));
+        append_bytes(buffer, grammar[r].rhs, grammar[r].length * sizeof(Symbol));
+    }
+    for (int id = 0; id < num_symbols; id++) {
+        int32_t precedence[2] = {symbol_precedence[id].level, symbol_precedence[id].assoc};
+        append_bytes(buffer, precedence, sizeof(precedence));
+    }
+}
+
+// 64-bit FNV-1a of a byte string
+uint64_t hash_bytes(const char *bytes, int size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Path of the cache file of a normalized grammar in a cache directory
+void cache_file_path(const char *cache_dir, const Array<char> *normalized, char *path, int size) {
+    snprintf(path, size, "%s/%016llx.lr1", cache_dir,
+             (unsigned long long)hash_bytes(normalized->data, normalized->size));
+}
+
+// Round an offset up to the next multiple of 8
+static inline uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// Write a table and its normalized grammar to a cache file, through a temporary file renamed
+// into place so that a reader never maps a partial file; returns false on I/O errors
+bool save_cached_table(const char *path, const Array<char> *normalized, const LR1Table *table) {
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.grammar_hash = hash_bytes(normalized->data, normalized->size);
+    header.num_states = table->num_states;
+    header.num_terminals = num_terminals;
+    header.num_non_terminals = num_non_terminals;
+    header.num_rules = grammar.size;
+    header.grammar_offset = align8(sizeof(CacheHeader));
+    header.grammar_size = normalized->size;
+    header.action_offset = align8(header.grammar_offset + header.grammar_size);
+    header.goto_offset = align8(header.action_offset + (uint64_t)table->num_states * num_terminals * sizeof(Action));
+    header.rule_length_offset = align8(header.goto_offset + (uint64_t)table->num_states * num_non_terminals * sizeof(int32_t));
+    header.rule_lhs_offset = align8(header.rule_length_offset + grammar.size * sizeof(int));
+    header.consistent_offset = align8(header.rule_lhs_offset + grammar.size * sizeof(Symbol));
+    header.file_size = header.consistent_offset + (uint64_t)table->num_states * sizeof(Action);
+
+    char temp_path[MAX_LINE + 16];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.tmp", path, (int)getpid());
+    FILE *file = fopen(temp_path, "wb");
+    if (file == NULL) return false;
+
+    // Each block starts at its offset, zero padding in between
+    struct { uint64_t offset; const void *data; uint64_t size; } blocks[] = {
+        {0, &header, sizeof(header)},
+        {header.grammar_offset, normalized->data, header.grammar_size},
+        {header.action_offset, table->action, (uint64_t)table->num_states * num_terminals * sizeof(Action)},
+        {header.goto_offset, table->goto_table, (uint64_t)table->num_states * num_non_terminals * sizeof(int32_t)},
+        {header.rule_length_offset, table->rule_length, grammar.size * sizeof(int)},
+        {header.rule_lhs_offset, table->rule_lhs, grammar.size * sizeof(Symbol)},
+        {header.consistent_offset, table->consistent, (uint64_t)table->num_states * sizeof(Action)},
+    };
+    static const char padding[8] = {0};
+    uint64_t written = 0;
+    bool ok = true;
+    for (int b = 0; b < (int)(sizeof(blocks) / sizeof(blocks[0])) && ok; b++) {
+        ok = fwrite(padding, 1, blocks[b].offset - written, file) == blocks[b].offset - written &&
+             fwrite(blocks[b].data, 1, blocks[b].size, file) == blocks[b].size;
+        written = blocks[b].offset + blocks[b].size;
+    }
+    if (fclose(file) != 0) ok = false;
+    if (ok && rename(temp_path, path) != 0) ok = false;
+    if (!ok) remove(temp_path);
+    return ok;
+}
+
+// Whether count elements of size bytes at offset lie inside a file of file_size bytes, past
+// the header and aligned for their type; written so that no product can overflow
+static bool cache_block_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t align, uint64_t file_size) {
+    return offset >= sizeof(CacheHeader) && offset % align == 0 && offset <= file_size &&
+           count <= (file_size - offset) / size;
+}
+
+// Whether an ACTION entry read from a cache file names an existing state or rule
+static bool cached_action_valid(Action action, int num_states) {
+    int value = action_value(action);
+    switch (action_type(action)) {
+        case ACTION_ERROR:        return action == 0 || action == EXPLICIT_ERROR;
+        case ACTION_SHIFT:        return value >= 0 && value < num_states;
+        case ACTION_REDUCE:
+        case ACTION_SHIFT_REDUCE: return value >= 0 && value < grammar.size;
+        case ACTION_ACCEPT:       return value == 0;
+        default:                  return false;
+    }
+}
+
+// Check the contents of a table mapped from a cache file, so that a stale or corrupted file
+// is rebuilt instead of sending the driver outside its arrays: every ACTION, GOTO and
+// consistent reduction must name an existing state or rule, and the rule arrays must agree
+// with the grammar
+bool cached_table_valid(const LR1Table *table) {
+    int num_states = table->num_states;
+    for (long e = 0; e < (long)num_states * num_terminals; e++) {
+        if (!cached_action_valid(table->action[e], num_states)) return false;
+    }
+    for (long e = 0; e < (long)num_states * num_non_terminals; e++) {
+        if (table->goto_table[e] < -1 || table->goto_table[e] >= num_states) return false;
+    }
+    for (int i = 0; i < num_states; i++) {
+        Action reduction = table->consistent[i];
+        if (reduction != 0 && (action_type(reduction) != ACTION_REDUCE || !cached_action_valid(reduction, num_states))) {
+            return false;
+        }
+    }
+    for (int r = 0; r < grammar.size; r++) {
+        if (table->rule_length[r] != grammar[r].length || table->rule_lhs[r] != grammar[r].lhs) return false;
+    }
+    return true;
+}
+
+// Map a cache file and point the table into it. Returns false, leaving the table untouched,
+// if the file is missing, truncated, from another version, built for another grammar, has
+// a block outside the file or a table entry naming no state or rule
+bool load_cached_table(const char *path, const Array<char> *normalized, LR1Table *table) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    const char *base = (const char *)mapping;
+    const CacheHeader *header = (const CacheHeader *)base;
+    uint64_t file_size = info.st_size;
+    uint64_t states = header->num_states > 0 ? (uint64_t)header->num_states : 0;
+    bool valid = header->magic == CACHE_MAGIC && header->version == CACHE_VERSION &&
+                 header->file_size == file_size &&
+                 header->num_terminals == num_terminals && header->num_non_terminals == num_non_terminals &&
+                 header->num_rules == grammar.size && header->num_states > 0 &&
+                 header->grammar_size == (uint64_t)normalized->size &&
+                 cache_block_fits(header->grammar_offset, header->grammar_size, 1, 1, file_size) &&
+                 cache_block_fits(header->action_offset, states * num_terminals, sizeof(Action), alignof(Action), file_size) &&
+                 cache_block_fits(header->goto_offset, states * num_non_terminals, sizeof(int32_t), alignof(int32_t), file_size) &&
+                 cache_block_fits(header->rule_length_offset, grammar.size, sizeof(int), alignof(int), file_size) &&
+                 cache_block_fits(header->rule_lhs_offset, grammar.size, sizeof(Symbol), alignof(Symbol), file_size) &&
+                 cache_block_fits(header->consistent_offset, states, sizeof(Action), alignof(Action), file_size) &&
+                 memcmp(base + header->grammar_offset, normalized->data, normalized->size) == 0;
+    if (!valid) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+
+    // The arrays are only read, so they can stay in the private read-only mapping
+    LR1Table mapped;
+    mapped.num_states = header->num_states;
+    mapped.action = (Action *)(base + header->action_offset);
+    mapped.goto_table = (int32_t *)(base + header->goto_offset);
+    mapped.rule_length = (int *)(base + header->rule_length_offset);
+    mapped.rule_lhs = (Symbol *)(base + header->rule_lhs_offset);
+    mapped.consistent = (Action *)(base + header->consistent_offset);
+    mapped.mapping = mapping;
+    mapped.mapping_size = info.st_size;
+    if (!cached_table_valid(&mapped)) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    *table = mapped;
+    return true;
+}
+
+// Growable comb vector shared by the rows (or columns) packed into it
+typedef struct {
+    int32_t *next;  // Packed entries
+    int *check;     // Key owning each slot, -1 if free
+    bool *used;     // Displacements already taken by a row
+    int size;       // Slots in use, padded so that base + key never overflows
+    int capacity;
+} CombVector;
+
+// ACTION and GOTO tables packed into comb vectors (row displacement, as bison does)
+typedef struct {
+    int num_states;
+    int num_rows;              // Distinct ACTION rows after deduplication
+    int *action_base;          // Per state: displacement of its row, CONSISTENT_STATE if it has none
+    Action *default_action;    // Per state: default reduction, taken when the check fails
+    CombVector actions;        // Keyed by terminal
+    int *goto_base;            // Per non-terminal (A - num_terminals): displacement of its column
+    int *goto_default;         // Per non-terminal: most frequent target
+    CombVector gotos;          // Keyed by state
+    int *rule_length;
+    Symbol *rule_lhs;
+} PackedTable;
+
+// action_base of a consistent state: its row is the default reduction alone, taken without
+// reading the lookahead (yypact_ninf in bison)
+#define CONSISTENT_STATE -1
+
+// Make room for at least capacity slots, new slots are free
+void comb_reserve(CombVector *comb, int capacity) {
+    if (capacity <= comb->capacity) return;
+    int new_capacity = comb->capacity > 0 ? comb->capacity : 256;
+    while (new_capacity < capacity) new_capacity *= 2;
+
+    comb->next = (int32_t *)realloc(comb->next, new_capacity * sizeof(int32_t));
+    comb->check = (int *)realloc(comb->check, new_capacity * sizeof(int));
+    comb->used = (bool *)realloc(comb->used, new_capacity * sizeof(bool));
+    if (comb->next == NULL || comb->check == NULL || comb->used == NULL) {
+        printf("Error: out of memory while packing the table\n");
+        exit(1);
+    }
+    for (int i = comb->capacity; i < new_capacity; i++) {
+        comb->next[i] = 0;
+        comb->check[i] = -1;
+        comb->used[i] = false;
+    }
+    comb->capacity = new_capacity;
+}
+
+// First-fit a sparse row into the comb, return its displacement.
+// Every lookup base + key with 0 <= key < key_range stays inside the vector.
+int comb_insert(CombVector *comb, const int *keys, const int32_t *values, int count, int key_range) {
+    int base = 0;
+    while (true) {
+        comb_reserve(comb, base + key_range);
+        bool fits = !comb->used[base];
+        for (int k = 0; fits && k < count; k++) {
+            if (comb->check[base + keys[k]] != -1) fits = false;
+        }
+        if (fits) break;
+        base++;
+    }
+
+    comb->used[base] = true;
+    for (int k = 0; k < count; k++) {
+        comb->check[base + keys[k]] = keys[k];
+        comb->next[base + keys[k]] = values[k];
+    }
+    if (base + key_range > comb->size) comb->size = base + key_range;
+    return base;
+}
+
+// Most frequent reduction of a state, ACTION_ERROR if it has none.
+// count is scratch space of one zeroed counter per rule, left zeroed on return.
+Action default_reduction(const LR1Table *table, int state, int *count) {
+    int best_rule = -1;
+    const Action *row = &table->action[state * num_terminals];
+    for (int t = 0; t < num_terminals; t++) {
+        Action action = row[t];
+        if (action_type(action) != ACTION_REDUCE) continue;
+        int rule = action_value(action);
+        count[rule]++;
+        if (best_rule == -1 || count[rule] > count[best_rule] ||
+            (count[rule] == count[best_rule] && rule < best_rule)) {
+            best_rule = rule;
+        }
+    }
+    for (int t = 0; t < num_terminals; t++) {
+        if (action_type(row[t]) == ACTION_REDUCE) count[action_value(row[t])] = 0;
+    }
+    return best_rule == -1 ? make_action(ACTION_ERROR, 0) : make_action(ACTION_REDUCE, best_rule);
+}
+
+// Sort rows by decreasing number of entries, the densest rows are the hardest to place
+static int *sort_counts;
+int compare_rows(const void *a, const void *b) {
+    int ca = sort_counts[*(const int *)a], cb = sort_counts[*(const int *)b];
+    if (ca != cb) return cb - ca;
+    return *(const int *)a - *(const int *)b;
+}
+
+// Compress a dense table: default reductions, identical rows shared, the rest comb-packed
+void pack_table(const LR1Table *table, int num_states, PackedTable *packed) {
+    memset(packed, 0, sizeof(*packed));
+    packed->num_states = num_states;
+    packed->action_base = (int *)malloc(num_states * sizeof(int));
+    packed->default_action = (Action *)malloc(num_states * sizeof(Action));
+    packed->rule_length = (int *)malloc(grammar.size * sizeof(int));
+    packed->rule_lhs = (Symbol *)malloc(grammar.size * sizeof(Symbol));
+    packed->goto_base = (int *)malloc(num_non_terminals * sizeof(int));
+    packed->goto_default = (int *)malloc(num_non_terminals * sizeof(int));
+    memcpy(packed->rule_length, table->rule_length, grammar.size * sizeof(int));
+    memcpy(packed->rule_lhs, table->rule_lhs, grammar.size * sizeof(Symbol));
+    int *rule_count = (int *)calloc(grammar.size, sizeof(int));
+
+    // Find the distinct rows: a row is its default plus its dense ACTION entries
+    int *row_of_state = (int *)malloc(num_states * sizeof(int));
+    int *row_state = (int *)malloc(num_states * sizeof(int));  // First state of each distinct row
+    uint32_t *row_hash = (uint32_t *)malloc(num_states * sizeof(uint32_t));
+    int *row_count = (int *)malloc(num_states * sizeof(int));
+    int num_rows = 0;
+    for (int i = 0; i < num_states; i++) {
+        packed->default_action[i] = default_reduction(table, i, rule_count);
+
+        const Action *action_row = &table->action[i * num_terminals];
+        uint32_t hash = 2166136261u ^ (uint32_t)packed->default_action[i];
+        for (int t = 0; t < num_terminals; t++) {
+            hash = (hash ^ (uint32_t)action_row[t]) * 16777619u;
+        }
+
+        int row = -1;
+        for (int r = 0; r < num_rows && row == -1; r++) {
+            int j = row_state[r];
+            if (row_hash[r] == hash && packed->default_action[j] == packed->default_action[i] &&
+                memcmp(&table->action[j * num_terminals], action_row, num_terminals * sizeof(Action)) == 0) {
+                row = r;
+            }
+        }
+        if (row == -1) {
+            row = num_rows++;
+            row_state[row] = i;
+            row_hash[row] = hash;
+            row_count[row] = 0;
+            for (int t = 0; t < num_terminals; t++) {
+                Action action = action_row[t];
+                if (action != 0 && action != packed->default_action[i]) row_count[row]++;
+            }
+        }
+        row_of_state[i] = row;
+    }
+    packed->num_rows = num_rows;
+
+    // Pack the distinct rows, densest first
+    int *order = (int *)malloc(num_rows * sizeof(int));
+    int *row_base = (int *)malloc(num_rows * sizeof(int));
+    for (int r = 0; r < num_rows; r++) order[r] = r;
+    sort_counts = row_count;
+    qsort(order, num_rows, sizeof(int), compare_rows);
+
+    int keys[MAX_TERMINALS];
+    int32_t values[MAX_TERMINALS];
+    for (int o = 0; o < num_rows; o++) {
+        int r = order[o], i = row_state[r], count = 0;
+        if (table->consistent[i] != 0) {
+            row_base[r] = CONSISTENT_STATE;
+            continue;
+        }
+        for (int t = 0; t < num_terminals; t++) {
+            Action action = table->action[i * num_terminals + t];
+            if (action != 0 && action != packed->default_action[i]) {
+                keys[count] = t;
+                values[count++] = action;
+            }
+        }
+        row_base[r] = comb_insert(&packed->actions, keys, values, count, num_terminals);
+    }
+    for (int i = 0; i < num_states; i++) {
+        packed->action_base[i] = row_base[row_of_state[i]];
+    }
+
+    // GOTO columns: the most frequent target becomes the default, the rest is packed by state
+    int *column_keys = (int *)malloc(num_states * sizeof(int));
+    int32_t *column_values = (int32_t *)malloc(num_states * sizeof(int32_t));
+    int *target_count = (int *)calloc(num_states, sizeof(int));
+    for (int n = 0; n < num_non_terminals; n++) {
+        int best = -1;
+        for (int i = 0; i < num_states; i++) {
+            int target = table->goto_table[i * num_non_terminals + n];
+            if (target == -1) continue;
+            target_count[target]++;
+            if (best == -1 || target_count[target] > target_count[best]) best = target;
+        }
+        int count = 0;
+        for (int i = 0; i < num_states; i++) {
+            int target = table->goto_table[i * num_non_terminals + n];
+            if (target == -1) continue;
+            target_count[target] = 0;
+            if (target != best) {
+                column_keys[count] = i;
+                column_values[count++] = target;
+            }
+        }
+        packed->goto_default[n] = best;
+        packed->goto_base[n] = comb_insert(&packed->gotos, column_keys, column_values, count, num_states);
+    }
+
+    free(rule_count);
+    free(row_of_state);
+    free(row_state);
+    free(row_hash);
+    free(row_count);
+    free(order);
+    free(row_base);
+    free(column_keys);
+    free(column_values);
+    free(target_count);
+}
+
+// Release the storage of a packed table
+void free_packed_table(PackedTable *packed) {
+    free(packed->action_base);
+    free(packed->default_action);
+    free(packed->actions.next);
+    free(packed->actions.check);
+    free(packed->actions.used);
+    free(packed->gotos.next);
+    free(packed->gotos.check);
+    free(packed->gotos.used);
+    free(packed->goto_base);
+    free(packed->goto_default);
+    free(packed->rule_length);
+    free(packed->rule_lhs);
+}
+
+// ACTION[state, symbol] read from the comb vector, the lookahead is not looked at in a consistent state
+static inline Action packed_action(const PackedTable *packed, int state, int symbol) {
+    int base = packed->action_base[state];
+    if (base == CONSISTENT_STATE) return packed->default_action[state];
+    int slot = base + symbol;
+    return packed->actions.check[slot] == symbol ? packed->actions.next[slot] : packed->default_action[state];
+}
+
+// GOTO[state, A] read from the comb vector
+static inline int packed_goto(const PackedTable *packed, int state, int A) {
+    int n = A - num_terminals;
+    int slot = packed->goto_base[n] + state;
+    return packed->gotos.check[slot] == state ? packed->gotos.next[slot] : packed->goto_default[n];
+}
+
+// Print the RHS of a rule with a dot at position dot (-1 for no dot)
+void print_rhs(const Rule *rule, int dot) {
+    const char *separator = "";
+    for (int i = 0; i <= rule->length; i++) {
+        if (i == dot) {
+            printf("%s.", separator);
+            separator = symbol_separator;
+        }
+        if (i < rule->length) {
+            printf("%s%s", separator, symbol_names[rule->rhs[i]]);
+            separator = symbol_separator;
+        }
+    }
+}
+
+// Display the FIRST sets, epsilon for nullable non-terminals
+void print_first_sets(const FirstSets *first_sets) {
+    printf("FIRST sets:\n");
+    for (int nt = num_terminals; nt < num_symbols; nt++) {
+        printf("FIRST(%s) = { ", symbol_names[nt]);
+        bool first = true;
+        for (int t = set_next(&first_sets->first[nt], 0); t >= 0; t = set_next(&first_sets->first[nt], t + 1)) {
+            if (!first) printf(", ");
+            printf("%s", symbol_names[t]);
+            first = false;
+        }
+        if (first_sets->nullable[nt]) {
+            if (!first) printf(", ");
+            printf("epsilon");
+        }
+        printf(" }\n");
+    }
+    printf("\n");
+}
+
+// Print an LR(1) item
+void print_item(LR1Item item) {
+    Rule *rule = &grammar[item.rule_index];
+    printf("[%s -> ", symbol_names[rule->lhs]);
+    print_rhs(rule, item.dot_position);
+    printf(", ");
+    for (int a = set_next(&item.lookaheads, 0); a >= 0; a = set_next(&item.lookaheads, a + 1)) {
+        printf(a == set_next(&item.lookaheads, 0) ? "%s" : "/%s", symbol_names[a]);
+    }
+    printf("]");
+}
+
+// Print an LR(1) state
+void print_state(LR1Automaton *automaton, int state_num) {
+    const LR1Item *items = state_items(automaton, state_num);
+    printf("State %d:\n", state_num);
+    for (int i = 0; i < automaton->states[state_num].num_items; i++) {
+        printf("  ");
+        print_item(items[i]);
+        printf("\n");
+    }
+}
+
+// Print the LR(1) table
+void print_table(LR1Table *table, int num_states) {
+    printf("\nACTION TABLE:\n");
+    
+    // Header with all terminals
+    printf("State\t");
+    for (int t = 0; t < num_terminals; t++) {
+        printf("%s\t", symbol_names[t]);
     }
     printf("\n");
     
@@ -475,340 +2206,1372 @@ void print_table(LR1Table *table, int num_states) {
     for (int t = 0; t < num_terminals; t++) {
         printf("--------");
     }
-    printf("\n");
-    
-    // ACTION table content
-    for (int i = 0; i < num_states; i++) {
-        printf("%d\t", i);
-        
-        for (int t = 0; t < num_terminals; t++) {
-            char term = terminals[t];
-            if (table->action[i][term][0] != 0) {
-                printf("%s\t", table->action[i][term]);
+    printf("\n");
+    
+    // ACTION table content
+    for (int i = 0; i < num_states; i++) {
+        printf("%d\t", i);
+        
+        for (int t = 0; t < num_terminals; t++) {
+            char text[16];
+            printf("%s\t", format_action(table->action[i * num_terminals + t], text));
+        }
+        printf("\n");
+    }
+    
+    printf("\nGOTO TABLE:\n");
+    
+    // Header with all non-terminals
+    printf("State\t");
+    for (int n = 0; n < num_non_terminals; n++) {
+        printf("%s\t", symbol_names[num_terminals + n]);
+    }
+    printf("\n");
+    
+    // Separator line
+    printf("-----");
+    for (int n = 0; n < num_non_terminals; n++) {
+        printf("--------");
+    }
+    printf("\n");
+    
+    // GOTO table content
+    for (int i = 0; i < num_states; i++) {
+        printf("%d\t", i);
+        
+        for (int n = 0; n < num_non_terminals; n++) {
+            int target = table->goto_table[i * num_non_terminals + n];
+            if (target != -1) {
+                printf("%d\t", target);
+            } else {
+                printf("\t");
+            }
+        }
+        printf("\n");
+    }
+}
+
+// Length of the token starting at p: one character, or a run of non-blanks in named grammars
+static inline int token_length(const char *p) {
+    if (symbol_separator[0] == 0) return 1;
+    int length = 0;
+    while (p[length] != 0 && !isspace((unsigned char)p[length])) length++;
+    return length;
+}
+
+// Split an input line into terminal IDs, up to and including the end marker $.
+// One-character grammars take every character as a token, named grammars split on whitespace.
+// With end_optional the end of the line stands for a missing $. Returns -1, or the offset of the
+// first token that is not a terminal (the end of the line when $ is missing).
+int scan_tokens(const char *input, Array<Symbol> *tokens, bool end_optional) {
+    tokens->size = 0;
+    const char *p = input;
+    while (true) {
+        if (symbol_separator[0] != 0) {
+            while (isspace((unsigned char)*p)) p++;
+        }
+        if (*p == 0) {
+            if (!end_optional) return p - input;
+            array_push(tokens, (Symbol)END_SYMBOL);
+            return -1;
+        }
+
+        int length = token_length(p);
+        int symbol = find_symbol(p, length);
+        if (symbol == -1 || !is_terminal(symbol)) return p - input;
+        array_push(tokens, (Symbol)symbol);
+        if (symbol == END_SYMBOL) return -1;
+        p += length;
+    }
+}
+
+// Tokenize an input line typed by the user, explaining what is wrong with it
+bool tokenize_input(const char *input, Array<Symbol> *tokens) {
+    int error = scan_tokens(input, tokens, false);
+    if (error == -1) return true;
+    if (input[error] == 0) {
+        printf("Error: the input does not end with $\n");
+    } else {
+        printf("Error: '%.*s' is not a terminal of the grammar\n", token_length(input + error), input + error);
+    }
+    return false;
+}
+
+// Observers of the LR driver, picked at compile time. Every hook of NoTrace is an empty inline
+// function, so the silent driver keeps no trace of the tracing.
+struct NoTrace {
+    void step(const int *, int, Symbol) {}
+    void shift(int) {}
+    void reduce(int, bool) {}
+    void accept() {}
+    void error(int, Symbol) {}
+    void goto_error(int, Symbol) {}
+};
+
+// Print every step: the stack, the lookahead and the action taken
+struct StepTrace {
+    int steps;
+
+    void step(const int *stack, int top, Symbol symbol) {
+        printf("%d\t", ++steps);
+        printf("[");
+        for (int j = 0; j <= top; j++) {
+            printf("%d", stack[j]);
+            if (j < top) printf(" ");
+        }
+        printf("]\t%s\t", symbol_names[symbol]);
+    }
+    void shift(int state) {
+        printf("Shift %d\n", state);
+    }
+    void reduce(int rule_index, bool fused) {
+        printf(fused ? "Shift and reduce by %s -> " : "Reduce by %s -> ", symbol_names[grammar[rule_index].lhs]);
+        print_rhs(&grammar[rule_index], -1);
+        printf("\n");
+    }
+    void accept() {
+        printf("Accept\n");
+    }
+    void error(int state, Symbol symbol) {
+        printf("Error: No action defined for state %d and symbol %s\n", state, symbol_names[symbol]);
+    }
+    void goto_error(int state, Symbol lhs) {
+        printf("Error: No GOTO defined for state %d and non-terminal %s\n", state, symbol_names[lhs]);
+    }
+};
+
+// Count the loop iterations, shifts and reductions (fused shift-reduce actions apart)
+struct Counters {
+    long steps, shifts, reductions, fused;
+
+    void step(const int *, int, Symbol) { steps++; }
+    void shift(int) { shifts++; }
+    void reduce(int, bool is_fused) {
+        if (is_fused) fused++;
+        else reductions++;
+    }
+    void accept() {}
+    void error(int, Symbol) {}
+    void goto_error(int, Symbol) {}
+};
+
+// Storage of the driver's state stack: the inline buffer first, then a heap block doubled each
+// time it fills up. The driver keeps the top index and a copy of data in locals, so that
+// stores into the stack cannot alias them. The storage points into itself, never copy it.
+typedef struct {
+    int *data;
+    int capacity;
+    int inline_data[INLINE_STACK];
+} ParseStack;
+
+// Start with the inline buffer, return where the states go
+int *stack_init(ParseStack *stack) {
+    stack->data = stack->inline_data;
+    stack->capacity = INLINE_STACK;
+    return stack->data;
+}
+
+// Double the capacity of a full stack, return the new location of the states. Out of line:
+// it runs a handful of times per parse at most, and the push stays one comparison.
+__attribute__((noinline)) int *stack_grow(ParseStack *stack) {
+    int *grown = (int *)malloc(2 * (size_t)stack->capacity * sizeof(int));
+    if (grown == NULL) {
+        printf("Error: out of memory for a parse stack of %d states\n", 2 * stack->capacity);
+        exit(1);
+    }
+    memcpy(grown, stack->data, stack->capacity * sizeof(int));
+    if (stack->data != stack->inline_data) free(stack->data);
+    stack->data = grown;
+    stack->capacity *= 2;
+    return grown;
+}
+
+// Release the heap block of a stack, if it has one
+void stack_free(ParseStack *stack) {
+    if (stack->data != stack->inline_data) free(stack->data);
+}
+
+// ACTION and GOTO as the driver reads them from a dense table: consistent states first
+static inline Action driver_action(const LR1Table *table, int state, Symbol symbol) {
+    Action action = table->consistent[state];
+    return action != 0 ? action : table->action[state * num_terminals + symbol];
+}
+
+static inline int driver_goto(const LR1Table *table, int state, Symbol A) {
+    return table->goto_table[state * num_non_terminals + A - num_terminals];
+}
+
+// ACTION and GOTO as the driver reads them from a packed table
+static inline Action driver_action(const PackedTable *packed, int state, Symbol symbol) {
+    return packed_action(packed, state, symbol);
+}
+
+static inline int driver_goto(const PackedTable *packed, int state, Symbol A) {
+    return packed_goto(packed, state, A);
+}
+
+// The LR driver, for either table and any observer. Tokens end with $. On error,
+// error_position (if not NULL) is the index of the token the error was detected on.
+template <typename Table, typename Observer>
+bool run_parser(const Symbol *tokens, const Table *table, Observer &observer, int *error_position) {
+    ParseStack storage;
+    int *stack = stack_init(&storage);  // State stack
+    int top = 0, capacity = storage.capacity;
+    stack[0] = 0;
+    int i = 0;
+    Symbol symbol = tokens[0];
+    bool accepted = false;
+
+    while (true) {
+        int state = stack[top];
+        observer.step(stack, top, symbol);
+        Action action = driver_action(table, state, symbol);
+        int type = action_type(action), value = action_value(action);
+
+        // Shift-reduce: the shifted state would be popped at once, count it without pushing it
+        if (type == ACTION_SHIFT_REDUCE) {
+            symbol = tokens[++i];
+            top++;
+        }
+        if (type == ACTION_REDUCE || type == ACTION_SHIFT_REDUCE) {
+            // Pop the RHS, then GOTO on the LHS from the uncovered state
+            observer.reduce(value, type == ACTION_SHIFT_REDUCE);
+            Symbol lhs = table->rule_lhs[value];
+            top -= table->rule_length[value];
+            value = driver_goto(table, stack[top], lhs);
+            if (value == -1) {
+                observer.goto_error(stack[top], lhs);
+                break;
+            }
+        } else if (type == ACTION_SHIFT) {
+            observer.shift(value);
+            symbol = tokens[++i];
+        } else if (type == ACTION_ACCEPT) {
+            observer.accept();
+            accepted = true;
+            break;
+        } else {
+            observer.error(state, symbol);
+            break;
+        }
+
+        // Push the shifted or GOTO state, in the rare case of a full stack after growing it
+        if (__builtin_expect(top + 1 == capacity, 0)) {
+            stack = stack_grow(&storage);
+            capacity = storage.capacity;
+        }
+        stack[++top] = value;
+    }
+    stack_free(&storage);
+    if (!accepted && error_position != NULL) *error_position = i;
+    return accepted;
+}
+
+// Parse a tokenized input string, printing every step
+template <typename Table>
+bool parse_input(const char *input, const Symbol *tokens, const Table *table) {
+    printf("Parsing input: %s\n", input);
+    printf("Step\tStack\tSymbol\tAction\n");
+    printf("--------------------------------------\n");
+    StepTrace trace = {0};
+    return run_parser(tokens, table, trace, NULL);
+}
+
+// Print the size of the dense and packed tables and the cost of an ACTION lookup in each
+void print_packed_report(const LR1Table *table, const PackedTable *packed) {
+    int n = packed->num_states;
+    size_t dense_used = n * (num_terminals * sizeof(Action) + num_non_terminals * sizeof(int32_t));
+    size_t packed_bytes = n * (sizeof(int) + sizeof(Action))
+                        + packed->actions.size * (sizeof(int32_t) + sizeof(int))
+                        + packed->gotos.size * (sizeof(int32_t) + sizeof(int))
+                        + num_non_terminals * 2 * sizeof(int);
+
+    printf("\nPACKED TABLE:\n");
+    printf("Dense:  %zu bytes for %d states x %d symbols\n",
+           dense_used, n, num_terminals + num_non_terminals);
+    printf("Packed: %zu bytes (%d distinct rows for %d states, %d ACTION slots, %d GOTO slots)\n",
+           packed_bytes, packed->num_rows, n, packed->actions.size, packed->gotos.size);
+
+    // Time every (state, terminal) lookup, repeated until about 10 million lookups
+    int lookups = n * num_terminals;
+    int reps = lookups > 0 ? 10000000 / lookups + 1 : 1;
+    volatile Action sink = 0;
+
+    clock_t start = clock();
+    for (int r = 0; r < reps; r++)
+        for (int i = 0; i < n; i++)
+            for (int t = 0; t < num_terminals; t++) sink = sink + table->action[i * num_terminals + t];
+    double dense_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)reps * lookups);
+
+    start = clock();
+    for (int r = 0; r < reps; r++)
+        for (int i = 0; i < n; i++)
+            for (int t = 0; t < num_terminals; t++) sink = sink + packed_action(packed, i, t);
+    double packed_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)reps * lookups);
+
+    printf("ACTION lookup: dense %.2f ns (1 load), packed %.2f ns (base + check + entry or default)\n",
+           dense_ns, packed_ns);
+}
+
+// A rejected line of a corpus: a token that is not a terminal, or the token a parse error was found on
+typedef struct {
+    int line;
+    int start;     // Offset of the line in the corpus text
+    int column;    // Offset of the unknown token in the line, -1 for a parse error
+    int position;  // Index of the token the parse failed on
+    Symbol symbol;
+} BatchFailure;
+
+// Parse every non-empty line of a corpus file, $ at the end being optional, with a silent observer.
+// Prints the rejected lines with where they fail, then the counts and the throughput of the
+// tokenizer and driver (reading the file is not timed). Returns false if the file cannot be read.
+template <typename Table, typename Observer>
+bool run_batch_file(const char *path, const Table *table, Observer &observer, long *total_lines, long *total_tokens, double *total_ms) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("Error: cannot open corpus file %s\n", path);
+        return false;
+    }
+    Array<char> text = {NULL, 0, 0};
+    char chunk[65536];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) append_bytes(&text, chunk, got);
+    fclose(file);
+    array_push(&text, (char)0);
+
+    Array<Symbol> tokens = {NULL, 0, 0};
+    Array<BatchFailure> failures = {NULL, 0, 0};
+    int accepted = 0, rejected = 0;
+    long num_tokens = 0;
+    clock_t start = clock();
+    char *text_end = &text[text.size - 1];
+    int line_number = 0;
+    for (char *line = text.data; line < text_end;) {
+        // Cut the line in place, the next one starts after its newline
+        char *end = line + strcspn(line, "\n");
+        char *next = end < text_end ? end + 1 : end;
+        *end = 0;
+        if (end > line && end[-1] == '\r') end[-1] = 0;
+        line_number++;
+
+        if (line[strspn(line, " \t")] != 0) {
+            BatchFailure failure = {line_number, (int)(line - text.data), -1, 0, END_SYMBOL};
+            failure.column = scan_tokens(line, &tokens, true);
+            num_tokens += tokens.size;
+            if (failure.column == -1 && run_parser(tokens.data, table, observer, &failure.position)) {
+                accepted++;
             } else {
-                printf("\t");
+                rejected++;
+                if (failure.column == -1) failure.symbol = tokens[failure.position];
+                array_push(&failures, failure);
             }
         }
-        printf("\n");
+        line = next;
     }
-    
-    printf("\nGOTO TABLE:\n");
-    
-    // Header with all non-terminals
-    printf("State\t");
-    for (int n = 0; n < num_non_terminals; n++) {
-        printf("%c\t", non_terminals[n]);
+    double ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    for (int f = 0; f < failures.size; f++) {
+        BatchFailure failure = failures[f];
+        if (failure.column != -1) {
+            const char *lexeme = &text[failure.start + failure.column];
+            printf("%s:%d:%d: '%.*s' is not a terminal\n", path, failure.line, failure.column + 1,
+                   token_length(lexeme), lexeme);
+        } else {
+            printf("%s:%d: rejected at token %d (%s)\n", path, failure.line, failure.position + 1,
+                   symbol_names[failure.symbol]);
+        }
     }
+    printf("%s: %d lines, %d accepted, %d rejected, %ld tokens in %.3f ms", path,
+           accepted + rejected, accepted, rejected, num_tokens, ms);
+    if (ms > 0) printf(" (%.0f lines/s, %.0f tokens/s)", (accepted + rejected) * 1000.0 / ms, num_tokens * 1000.0 / ms);
     printf("\n");
-    
-    // Separator line
-    printf("-----");
-    for (int n = 0; n < num_non_terminals; n++) {
-        printf("--------");
+
+    *total_lines += accepted + rejected;
+    *total_tokens += num_tokens;
+    *total_ms += ms;
+    array_free(&text);
+    array_free(&tokens);
+    array_free(&failures);
+    return true;
+}
+
+// Parse the corpus files one after the other, with a total when there are several
+template <typename Table, typename Observer>
+bool run_batch(char **paths, int num_paths, const Table *table, Observer &observer) {
+    long total_lines = 0, total_tokens = 0;
+    double total_ms = 0;
+    bool ok = true;
+    for (int f = 0; f < num_paths; f++) {
+        ok = run_batch_file(paths[f], table, observer, &total_lines, &total_tokens, &total_ms) && ok;
     }
-    printf("\n");
-    
-    // GOTO table content
+    if (num_paths > 1) {
+        printf("total: %ld lines, %ld tokens in %.3f ms\n", total_lines, total_tokens, total_ms);
+    }
+    return ok;
+}
+
+// Write an integer array as a static const C array of the narrowest type that holds its values
+void emit_array(FILE *file, const char *type_prefix, const char *name, const int32_t *values, int count) {
+    int32_t lo = 0, hi = 0;
+    for (int i = 0; i < count; i++) {
+        if (values[i] < lo) lo = values[i];
+        if (values[i] > hi) hi = values[i];
+    }
+    const char *type = lo >= INT8_MIN && hi <= INT8_MAX ? "int8_t" : lo >= INT16_MIN && hi <= INT16_MAX ? "int16_t" : "int32_t";
+
+    fprintf(file, "static const %s %s_%s[%d] = {", type, type_prefix, name, count > 0 ? count : 1);
+    for (int i = 0; i < count; i++) {
+        fprintf(file, i % 12 == 0 ? "\n    %d," : " %d,", values[i]);
+    }
+    fprintf(file, count > 0 ? "\n};\n\n" : "0};\n\n");
+}
+
+// Check if a symbol name can be used as part of a C identifier
+bool is_identifier_name(const char *name) {
+    if (!isalpha((unsigned char)name[0]) && name[0] != '_') return false;
+    for (const char *c = name; *c; c++) {
+        if (!isalnum((unsigned char)*c) && *c != '_') return false;
+    }
+    return true;
+}
+
+// Write a symbol name as a C string literal
+void emit_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Names used by a generated parser written to PATH: base name of PATH, and identifier
+// prefixes in lower case (functions, tables) and upper case (macros)
+typedef struct {
+    const char *base;
+    char lower[MAX_LINE];
+    char upper[MAX_LINE];
+} ParserNames;
+
+// Derive the names of a generated parser from its path
+void parser_names(const char *path, ParserNames *names) {
+    names->base = strrchr(path, '/') != NULL ? strrchr(path, '/') + 1 : path;
+    int length = 0;
+    if (isdigit((unsigned char)names->base[0])) names->lower[length++] = '_';
+    for (const char *c = names->base; *c && length < MAX_LINE - 1; c++) {
+        names->lower[length++] = isalnum((unsigned char)*c) ? tolower((unsigned char)*c) : '_';
+    }
+    names->lower[length] = 0;
+    for (int i = 0; i <= length; i++) names->upper[i] = toupper((unsigned char)names->lower[i]);
+}
+
+// Write PATH.h, the same for every backend: token IDs, symbol names and the parse entry point
+bool emit_parser_header(const char *path, const ParserNames *names, const char *kind, BuildMode mode, int num_states) {
+    char header_path[MAX_LINE + 8];
+    snprintf(header_path, sizeof(header_path), "%s.h", path);
+    FILE *header = fopen(header_path, "w");
+    if (header == NULL) return false;
+
+    const char *lower = names->lower, *upper = names->upper;
+    fprintf(header, "// %s.h: %s %s parser generated by Complete.cpp (%d states), do not edit\n",
+            names->base, build_mode_names[mode], kind, num_states);
+    fprintf(header, "#ifndef %s_PARSER_H\n#define %s_PARSER_H\n\n", upper, upper);
+    fprintf(header, "#include <stdint.h>\n#include <stdbool.h>\n\n");
+    fprintf(header, "// Terminal IDs, the values the token array passed to %s_parse holds\nenum {\n", lower);
+    for (int t = 0; t < num_terminals; t++) {
+        fprintf(header, "    %s_TOKEN_", upper);
+        if (t == END_SYMBOL) {
+            fprintf(header, "END");
+        } else if (is_identifier_name(symbol_names[t]) && strcmp(symbol_names[t], "END") != 0) {
+            fprintf(header, "%s", symbol_names[t]);
+        } else {
+            fprintf(header, "%d", t);
+        }
+        fprintf(header, " = %d,  // %s\n", t, symbol_names[t]);
+    }
+    fprintf(header, "};\n\n");
+    fprintf(header, "#define %s_NUM_TERMINALS %d\n#define %s_NUM_SYMBOLS %d\n\n", upper, num_terminals, upper, num_symbols);
+    fprintf(header, "// Name of every symbol by ID, terminals first\n");
+    fprintf(header, "extern const char *const %s_symbol_names[%s_NUM_SYMBOLS];\n\n", lower, upper);
+    fprintf(header, "// ID of a terminal name, -1 if the grammar has no such terminal\n");
+    fprintf(header, "int %s_find_token(const char *name);\n\n", lower);
+    fprintf(header, "// Parse a token array ending with %s_TOKEN_END. On a syntax error, *error_position\n", upper);
+    fprintf(header, "// (unless NULL) receives the index of the token that could not be shifted\n");
+    fprintf(header, "bool %s_parse(const uint16_t *tokens, int *error_position);\n\n", lower);
+    fprintf(header, "#endif\n");
+    return fclose(header) == 0;
+}
+
+// Open PATH.cpp and write its preamble: includes, symbol names and find_token
+FILE *begin_parser_source(const char *path, const ParserNames *names, const char *kind, BuildMode mode, int num_states) {
+    char source_path[MAX_LINE + 8];
+    snprintf(source_path, sizeof(source_path), "%s.cpp", path);
+    FILE *source = fopen(source_path, "w");
+    if (source == NULL) return NULL;
+
+    const char *lower = names->lower, *upper = names->upper;
+    fprintf(source, "// %s.cpp: %s %s parser generated by Complete.cpp (%d states), do not edit\n",
+            names->base, build_mode_names[mode], kind, num_states);
+    fprintf(source, "#include \"%s.h\"\n\n#include <stdlib.h>\n#include <string.h>\n\n", names->base);
+
+    fprintf(source, "const char *const %s_symbol_names[%s_NUM_SYMBOLS] = {", lower, upper);
+    for (int id = 0; id < num_symbols; id++) {
+        fprintf(source, id % 8 == 0 ? "\n    " : " ");
+        emit_string(source, symbol_names[id]);
+        fprintf(source, ",");
+    }
+    fprintf(source, "\n};\n\n");
+    fprintf(source,
+        "int %1$s_find_token(const char *name) {\n"
+        "    for (int t = 0; t < %2$s_NUM_TERMINALS; t++) {\n"
+        "        if (strcmp(%1$s_symbol_names[t], name) == 0) return t;\n"
+        "    }\n"
+        "    return -1;\n"
+        "}\n\n", lower, upper);
+    return source;
+}
+
+// Write a packed table as a standalone parser: PATH.h declares the token IDs and the entry
+// points, PATH.cpp holds the tables as static const arrays and the driver. Identifiers are
+// prefixed with the base name of PATH. Returns false if a file cannot be written.
+bool emit_parser(const char *path, const PackedTable *packed, BuildMode mode) {
+    ParserNames names;
+    parser_names(path, &names);
+    const char *lower = names.lower;
+    if (!emit_parser_header(path, &names, "table-driven", mode, packed->num_states)) return false;
+    FILE *source = begin_parser_source(path, &names, "table-driven", mode, packed->num_states);
+    if (source == NULL) return false;
+
+    // Tables: ACTION entries are (value << 3) | type as in the generator, GOTO is indexed by
+    // A - NUM_TERMINALS, and rule_lhs already holds that index
+    int num_rules = grammar.size;
+    int32_t *values = (int32_t *)malloc(num_rules * sizeof(int32_t));
+    fprintf(source, "// ACTION[state][t] = action_check[action_base[state] + t] == t ? action_next[...] : default_action[state],\n");
+    fprintf(source, "// or default_action[state] whatever t when action_base[state] is %d (consistent state)\n", CONSISTENT_STATE);
+    emit_array(source, lower, "action_base", packed->action_base, packed->num_states);
+    emit_array(source, lower, "default_action", packed->default_action, packed->num_states);
+    emit_array(source, lower, "action_next", packed->actions.next, packed->actions.size);
+    emit_array(source, lower, "action_check", packed->actions.check, packed->actions.size);
+    fprintf(source, "// GOTO[state][A] = goto_check[goto_base[A] + state] == state ? goto_next[...] : goto_default[A]\n");
+    emit_array(source, lower, "goto_base", packed->goto_base, num_non_terminals);
+    emit_array(source, lower, "goto_default", packed->goto_default, num_non_terminals);
+    emit_array(source, lower, "goto_next", packed->gotos.next, packed->gotos.size);
+    emit_array(source, lower, "goto_check", packed->gotos.check, packed->gotos.size);
+    emit_array(source, lower, "rule_length", packed->rule_length, num_rules);
+    for (int r = 0; r < num_rules; r++) values[r] = packed->rule_lhs[r] - num_terminals;
+    emit_array(source, lower, "rule_lhs", values, num_rules);
+    free(values);
+
+    fprintf(source,
+        "bool %1$s_parse(const uint16_t *tokens, int *error_position) {\n"
+        "    // State stack, on the C stack until it outgrows it\n"
+        "    int small_stack[64];\n"
+        "    int *stack = small_stack;\n"
+        "    int capacity = 64, top = 0, position = 0;\n"
+        "    stack[0] = 0;\n"
+        "    int symbol = tokens[0];\n"
+        "    bool accepted;\n\n"
+        "    while (true) {\n"
+        "        int state = stack[top];\n"
+        "        int slot = %1$s_action_base[state];\n"
+        "        int action = %1$s_default_action[state];\n"
+        "        if (slot != %2$d) {\n"
+        "            slot += symbol;\n"
+        "            if (%1$s_action_check[slot] == symbol) action = %1$s_action_next[slot];\n"
+        "        }\n"
+        "        int type = action & %3$d, value = action >> %4$d;\n\n"
+        "        // Shift-reduce: the shifted state would be popped at once, count it without pushing it\n"
+        "        if (type == %8$d) {\n"
+        "            symbol = tokens[++position];\n"
+        "            top++;\n"
+        "            type = %6$d;\n"
+        "        }\n"
+        "        if (type == %6$d) {\n"
+        "            // Reduce: pop the RHS, then GOTO on the LHS from the uncovered state\n"
+        "            top -= %1$s_rule_length[value];\n"
+        "            int A = %1$s_rule_lhs[value];\n"
+        "            slot = %1$s_goto_base[A] + stack[top];\n"
+        "            value = %1$s_goto_check[slot] == stack[top] ? %1$s_goto_next[slot] : %1$s_goto_default[A];\n"
+        "        } else if (type == %5$d) {\n"
+        "            symbol = tokens[++position];\n"
+        "        } else {\n"
+        "            accepted = type == %7$d;\n"
+        "            break;\n"
+        "        }\n\n"
+        "        // Push the shifted or GOTO state\n"
+        "        if (top + 1 == capacity) {\n"
+        "            int *grown = (int *)malloc(2 * capacity * sizeof(int));\n"
+        "            memcpy(grown, stack, capacity * sizeof(int));\n"
+        "            if (stack != small_stack) free(stack);\n"
+        "            stack = grown;\n"
+        "            capacity *= 2;\n"
+        "        }\n"
+        "        stack[++top] = value;\n"
+        "    }\n\n"
+        "    if (stack != small_stack) free(stack);\n"
+        "    if (!accepted && error_position != NULL) *error_position = position;\n"
+        "    return accepted;\n"
+        "}\n", lower, CONSISTENT_STATE, (1 << ACTION_TYPE_BITS) - 1, ACTION_TYPE_BITS,
+        ACTION_SHIFT, ACTION_REDUCE, ACTION_ACCEPT, ACTION_SHIFT_REDUCE);
+    return fclose(source) == 0;
+}
+
+// Write a recursive-ascent parser with the same interface as emit_parser: every state is a
+// function that switches on the lookahead. A shift or GOTO calls the target state, so the C
+// call stack is the parse stack; a reduction by a rule of length n returns through n state
+// functions (pops counts them down) and the one uncovered does the GOTO. Each state takes its
+// most frequent reduction by default, as the packed table does; there is no table at all.
+bool emit_ascent_parser(const char *path, const LR1Table *table, BuildMode mode) {
+    ParserNames names;
+    parser_names(path, &names);
+    const char *lower = names.lower;
+    int num_states = table->num_states;
+    if (!emit_parser_header(path, &names, "recursive-ascent", mode, num_states)) return false;
+    FILE *source = begin_parser_source(path, &names, "recursive-ascent", mode, num_states);
+    if (source == NULL) return false;
+
+    fprintf(source,
+        "// Parser state shared by the state functions; status 0 while parsing, 1 accepted, 2 error\n"
+        "typedef struct {\n"
+        "    const uint16_t *tokens;\n"
+        "    int position;\n"
+        "    int symbol;   // Lookahead\n"
+        "    int pops;     // State functions still to return from for the current reduction\n"
+        "    int lhs;      // Non-terminal of the current reduction\n"
+        "    int status;\n"
+        "} %s_context;\n\n", lower);
+    bool *reachable = (bool *)malloc(num_states * sizeof(bool));
+    mark_reachable_states(table, reachable);
     for (int i = 0; i < num_states; i++) {
-        printf("%d\t", i);
-        
+        if (reachable[i]) fprintf(source, "static void %s_state_%d(%s_context *c);\n", lower, i, lower);
+    }
+    fprintf(source, "\n");
+
+    int *rule_count = (int *)calloc(grammar.size, sizeof(int));
+    bool *done = (bool *)malloc(num_terminals * sizeof(bool));
+    for (int i = 0; i < num_states; i++) {
+        // States bypassed by --skip-units are never entered
+        if (!reachable[i]) continue;
+        const Action *row = &table->action[i * num_terminals];
+        const int32_t *gotos = &table->goto_table[i * num_non_terminals];
+        Action default_action = default_reduction(table, i, rule_count);
+        bool has_shift = false, has_goto = false, has_empty_reduce = false;
+        for (int t = 0; t < num_terminals; t++) {
+            if (action_type(row[t]) == ACTION_SHIFT || action_type(row[t]) == ACTION_SHIFT_REDUCE) has_shift = true;
+            if (action_type(row[t]) == ACTION_REDUCE && table->rule_length[action_value(row[t])] == 0) has_empty_reduce = true;
+        }
         for (int n = 0; n < num_non_terminals; n++) {
-            char non_term = non_terminals[n];
-            if (table->goto_table[i][non_term] != -1) {
-                printf("%d\t", table->goto_table[i][non_term]);
+            if (gotos[n] != -1) has_goto = true;
+        }
+
+        // Dispatch on the lookahead: one case list per distinct action, the default reduction last
+        fprintf(source, "static void %s_state_%d(%s_context *c) {\n", lower, i, lower);
+        fprintf(source, "    switch (c->symbol) {\n");
+        memset(done, 0, num_terminals * sizeof(bool));
+        for (int t = 0; t <= num_terminals; t++) {
+            Action action;
+            if (t < num_terminals) {
+                if (done[t] || row[t] == 0 || row[t] == default_action) continue;
+                action = row[t];
+                for (int u = t; u < num_terminals; u++) {
+                    if (row[u] != action) continue;
+                    done[u] = true;
+                    fprintf(source, "    case %d:  // %s\n", u, symbol_names[u]);
+                }
             } else {
-                printf("\t");
+                action = default_action;
+                fprintf(source, "    default:\n");
+            }
+
+            int value = action_value(action);
+            switch (action_type(action)) {
+                case ACTION_SHIFT:
+                    fprintf(source, "        c->symbol = c->tokens[++c->position];\n");
+                    fprintf(source, "        %s_state_%d(c);\n        goto returned;\n", lower, value);
+                    break;
+                case ACTION_REDUCE:
+                    fprintf(source, "        c->lhs = %d;  // ", table->rule_lhs[value]);
+                    fprintf(source, "%s ->", symbol_names[grammar[value].lhs]);
+                    for (int k = 0; k < grammar[value].length; k++) fprintf(source, " %s", symbol_names[grammar[value].rhs[k]]);
+                    fprintf(source, "\n");
+                    if (table->rule_length[value] == 0) {
+                        fprintf(source, "        goto reduced;\n");
+                    } else {
+                        fprintf(source, "        c->pops = %d;\n        return;\n", table->rule_length[value]);
+                    }
+                    break;
+                case ACTION_SHIFT_REDUCE:
+                    // As if the callee had reduced at once: unwind from here
+                    fprintf(source, "        c->symbol = c->tokens[++c->position];\n");
+                    fprintf(source, "        c->lhs = %d;  // ", table->rule_lhs[value]);
+                    fprintf(source, "%s ->", symbol_names[grammar[value].lhs]);
+                    for (int k = 0; k < grammar[value].length; k++) fprintf(source, " %s", symbol_names[grammar[value].rhs[k]]);
+                    fprintf(source, "\n");
+                    fprintf(source, "        c->pops = %d;\n        goto returned;\n", table->rule_length[value]);
+                    break;
+                case ACTION_ACCEPT:
+                    fprintf(source, "        c->status = 1;\n        return;\n");
+                    break;
+                default:
+                    fprintf(source, "        c->status = 2;\n        return;\n");
+                    break;
             }
         }
-        printf("\n");
-    }
-}
+        fprintf(source, "    }\n");
 
-// Parse an input string with the LR(1) table
-bool parse_input(char *input, LR1Table *table, int num_states) {
-    int stack[MAX_STACK];  // State stack
-    int top = 0;           // Stack top
-    stack[top] = 0;        // Initial state
-    
-    int i = 0;
-    char symbol = input[i++];
-    
-    printf("Parsing input: %s\n", input);
-    printf("Step\tStack\tSymbol\tAction\n");
-    printf("--------------------------------------\n");
-    
-    int step = 1;
-    while (true) {
-        int state = stack[top];
-        
-        printf("%d\t", step++);
-        printf("[");
-        for (int j = 0; j <= top; j++) {
-            printf("%d", stack[j]);
-            if (j < top) printf(" ");
+        // Back from a callee: keep unwinding until the reduction has popped its RHS, then GOTO
+        if (has_shift || has_goto) {
+            fprintf(source, "returned:\n");
+            fprintf(source, "    if (c->status != 0 || --c->pops > 0) return;\n");
         }
-        printf("]\t%c\t", symbol);
-        
-        // Check action for current symbol
-        if (table->action[state][symbol][0] == 0) {
-            printf("Error: No action defined for state %d and symbol %c\n", state, symbol);
-            return false;
+        if (has_goto) {
+            if (has_empty_reduce) fprintf(source, "reduced:\n");
+            fprintf(source, "    switch (c->lhs) {\n");
+            for (int n = 0; n < num_non_terminals; n++) {
+                if (gotos[n] == -1) continue;
+                fprintf(source, "    case %d:  // %s\n", num_terminals + n, symbol_names[num_terminals + n]);
+                fprintf(source, "        %s_state_%d(c);\n        goto returned;\n", lower, gotos[n]);
+            }
+            fprintf(source, "    }\n");
         }
-        
-        if (strncmp(table->action[state][symbol], "s", 1) == 0) {
-            // Shift action
-            int next_state;
-            sscanf(table->action[state][symbol], "s%d", &next_state);
-            printf("Shift %d\n", next_state);
-            
-            stack[++top] = next_state;
-            symbol = input[i++];
-        }
-        else if (strncmp(table->action[state][symbol], "r", 1) == 0) {
-            // Reduce action
-            int rule_index;
-            sscanf(table->action[state][symbol], "r%d", &rule_index);
-            Rule rule = grammar[rule_index];
-            
-            printf("Reduce by %c -> ", rule.lhs);
-            for (int j = 0; j < rule.length; j++) {
-                printf("%c", rule.rhs[j]);
+        if (has_shift || has_goto) fprintf(source, "    c->status = 2;\n");
+        fprintf(source, "}\n\n");
+    }
+    free(rule_count);
+    free(done);
+    free(reachable);
+
+    fprintf(source,
+        "bool %1$s_parse(const uint16_t *tokens, int *error_position) {\n"
+        "    %1$s_context c = {tokens, 0, tokens[0], 0, 0, 0};\n"
+        "    %1$s_state_0(&c);\n"
+        "    if (c.status != 1 && error_position != NULL) *error_position = c.position;\n"
+        "    return c.status == 1;\n"
+        "}\n", lower);
+    return fclose(source) == 0;
+}
+
+// Derive a random sentence of the grammar with at least about length tokens, $ included.
+// While the sentence is short, rules deeper than the shallowest one of their LHS are picked
+// three times out of four so that it grows; then only the shallowest ones (least height, the
+// depth of the smallest derivation tree) so that the derivation ends. Returns false if S
+// derives nothing.
+bool random_sentence(int length, unsigned seed, Array<Symbol> *sentence) {
+    // height[A] by fixpoint, INT32_MAX while A derives no terminal string
+    int *height = (int *)malloc(num_symbols * sizeof(int));
+    int *rule_height = (int *)malloc(grammar.size * sizeof(int));
+    for (int X = 0; X < num_symbols; X++) height[X] = is_terminal(X) ? 0 : INT32_MAX;
+    bool changed;
+    do {
+        changed = false;
+        for (int r = 0; r < grammar.size; r++) {
+            int h = 0;
+            for (int k = 0; k < grammar[r].length && h != INT32_MAX; k++) {
+                int hk = height[grammar[r].rhs[k]];
+                h = hk == INT32_MAX ? INT32_MAX : (hk > h ? hk : h);
             }
-            printf("\n");
-            
-            // Pop states
-            top -= rule.length;
-            
-            // Check GOTO[s', A] where s' is the top state
-            int goto_state = table->goto_table[stack[top]][rule.lhs];
-            if (goto_state == -1) {
-                printf("Error: No GOTO defined for state %d and non-terminal %c\n", stack[top], rule.lhs);
-                return false;
+            rule_height[r] = h == INT32_MAX ? INT32_MAX : h + 1;
+            if (rule_height[r] < height[grammar[r].lhs]) {
+                height[grammar[r].lhs] = rule_height[r];
+                changed = true;
             }
-            stack[++top] = goto_state;
         }
-        else if (strcmp(table->action[state][symbol], "acc") == 0) {
-            printf("Accept\n");
-            return true;
+    } while (changed);
+
+    bool ok = height[grammar[0].lhs] != INT32_MAX;
+    Array<Symbol> pending = {NULL, 0, 0};  // Symbols still to expand, last one first
+    Array<int> choices = {NULL, 0, 0};
+    sentence->size = 0;
+    if (ok) array_push(&pending, grammar[0].rhs[0]);
+    srand(seed);
+    while (pending.size > 0) {
+        Symbol X = pending[--pending.size];
+        if (is_terminal(X)) {
+            array_push(sentence, X);
+            continue;
+        }
+
+        // Deeper rules of X to grow the sentence, or else its shallowest ones
+        choices.size = 0;
+        bool grow = sentence->size + pending.size < length && rand() % 4 != 0;
+        for (int r = 0; r < grammar.size; r++) {
+            if (grammar[r].lhs != X || rule_height[r] == INT32_MAX) continue;
+            if (grow && rule_height[r] > height[X]) array_push(&choices, r);
         }
-        else {
-            printf("Error: Invalid action %s\n", table->action[state][symbol]);
-            return false;
+        for (int r = 0; r < grammar.size && choices.size == 0; r++) {
+            if (grammar[r].lhs == X && rule_height[r] == height[X]) array_push(&choices, r);
         }
+        int r = choices[rand() % choices.size];
+        for (int k = grammar[r].length - 1; k >= 0; k--) array_push(&pending, grammar[r].rhs[k]);
     }
-    
-    return false;
+    array_push(sentence, (Symbol)END_SYMBOL);
+
+    free(height);
+    free(rule_height);
+    array_free(&pending);
+    array_free(&choices);
+    return ok;
 }
 
-// Read grammar from user input
-void read_grammar() {
-    printf("Enter grammar rules (one per line, format: 'X -> abc', use '%%' for epsilon, empty line to finish):\n");
-    
-    // Clear existing data
-    num_rules = 0;
-    num_terminals = 0;
-    num_non_terminals = 0;
-    memset(terminals, 0, sizeof(terminals));
-    memset(non_terminals, 0, sizeof(non_terminals));
-    memset(grammar, 0, sizeof(grammar)); // Clear grammar array too
+// Write PATH_table.{h,cpp}, PATH_ascent.{h,cpp} and PATH_bench.cpp, a program that times both
+// parsers on a random sentence of about length tokens, itself written into PATH_bench.cpp
+bool emit_benchmark(const char *path, const LR1Table *table, const PackedTable *packed, BuildMode mode, int length) {
+    char table_path[MAX_LINE + 16], ascent_path[MAX_LINE + 16], bench_path[MAX_LINE + 16];
+    snprintf(table_path, sizeof(table_path), "%s_table", path);
+    snprintf(ascent_path, sizeof(ascent_path), "%s_ascent", path);
+    snprintf(bench_path, sizeof(bench_path), "%s_bench.cpp", path);
+    if (!emit_parser(table_path, packed, mode) || !emit_ascent_parser(ascent_path, table, mode)) return false;
+
+    Array<Symbol> sentence = {NULL, 0, 0};
+    if (!random_sentence(length, 1, &sentence)) {
+        printf("Error: the start symbol derives no sentence\n");
+        return false;
+    }
+
+    ParserNames table_names, ascent_names;
+    parser_names(table_path, &table_names);
+    parser_names(ascent_path, &ascent_names);
+    FILE *bench = fopen(bench_path, "w");
+    if (bench == NULL) {
+        array_free(&sentence);
+        return false;
+    }
+    fprintf(bench, "// %s_bench.cpp: table-driven against recursive-ascent parsing, generated by Complete.cpp\n", table_names.base);
+    fprintf(bench, "// Build: g++ -O2 %s_bench.cpp %s.cpp %s.cpp\n", table_names.base, table_names.base, ascent_names.base);
+    fprintf(bench, "#include \"%s.h\"\n#include \"%s.h\"\n\n#include <stdio.h>\n#include <time.h>\n\n", table_names.base, ascent_names.base);
+    fprintf(bench, "// A random sentence of the grammar, %d tokens with $\nstatic const uint16_t sentence[%d] = {", sentence.size, sentence.size);
+    for (int i = 0; i < sentence.size; i++) fprintf(bench, i % 20 == 0 ? "\n    %d," : " %d,", sentence[i]);
+    fprintf(bench, "\n};\n\n");
+    fprintf(bench,
+        "int main() {\n"
+        "    // Repeat until about 50 million tokens have been parsed by each parser\n"
+        "    int reps = 50000000 / %1$d + 1;\n"
+        "    int accepted_table = 0, accepted_ascent = 0;\n\n"
+        "    clock_t start = clock();\n"
+        "    for (int r = 0; r < reps; r++) accepted_table += %2$s_parse(sentence, NULL);\n"
+        "    double table_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)reps * %1$d);\n\n"
+        "    start = clock();\n"
+        "    for (int r = 0; r < reps; r++) accepted_ascent += %3$s_parse(sentence, NULL);\n"
+        "    double ascent_ns = (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)reps * %1$d);\n\n"
+        "    printf(\"%%d-token sentence, %%d parses each\\n\", %1$d, reps);\n"
+        "    printf(\"  table-driven:     %%.2f ns/token (%%s)\\n\", table_ns, accepted_table == reps ? \"accepted\" : \"REJECTED\");\n"
+        "    printf(\"  recursive ascent: %%.2f ns/token (%%s)\\n\", ascent_ns, accepted_ascent == reps ? \"accepted\" : \"REJECTED\");\n"
+        "    return 0;\n"
+        "}\n", sentence.size, table_names.lower, ascent_names.lower);
+    array_free(&sentence);
+    return fclose(bench) == 0;
+}
+
+// Start a grammar: reset the symbol table and reserve rule 0 for the augmented rule
+void begin_grammar() {
+    reset_grammar();
+    Rule augmented = {0, (Symbol *)arena_alloc(&grammar_arena, sizeof(Symbol)), 1, END_SYMBOL};
+    array_push(&grammar, augmented);
+}
+
+// Finish a grammar: add S' -> S for the start symbol S (LHS of rule 1), then number the symbols
+void end_grammar() {
+    if (grammar.size == 1) {
+        printf("Error: No grammar rules entered.\n");
+        exit(1);
+    }
+    if (grammar.size > MAX_RULES) {
+        printf("Error: more than %d grammar rules\n", MAX_RULES);
+        exit(1);
+    }
+
+    // S' is the start symbol's name with quotes appended until it is unused
+    Symbol start = grammar[1].lhs;
+    int length = strlen(symbol_names[start]);
+    char *name = (char *)malloc(length + 2);
+    strcpy(name, symbol_names[start]);
+    do {
+        name = (char *)realloc(name, length + 2);
+        name[length++] = '\'';
+        name[length] = 0;
+    } while (find_symbol(name, length) != -1);
+    grammar[0].lhs = intern_symbol(name, length);
+    grammar[0].rhs[0] = start;
+    free(name);
+
+    finalize_symbols();
+}
+
+// Read grammar from user input, with a prompt unless it comes from a script
+void read_grammar(bool prompt) {
+    if (prompt) printf("Enter grammar rules (one per line, format: 'X -> abc', use '%%' for epsilon, empty line to finish):\n");
     
-    // Add $ as the first terminal
-    terminals[num_terminals++] = '$';
+    // Clear existing data, symbols are single characters
+    begin_grammar();
+    symbol_separator = "";
     
     char line[MAX_LINE];
-    bool first_rule = true;
-    char original_start_symbol = 0;
 
     while (1) {
         if (fgets(line, MAX_LINE, stdin) == NULL || line[0] == '\n' || line[0] == '\r') {
-            // Check if at least one rule was entered
-            if (num_rules == 0) {
-                 printf("Error: No grammar rules entered.\n");
-                 exit(1); // Or handle error appropriately
-            }
             break; // Finished reading
         }
         
         // Remove trailing newline
         line[strcspn(line, "\r\n")] = 0;
 
-        // Parse the rule (Example: "E -> E+T")
+        // "%left +-" declares the next precedence level, one symbol per character
+        const char *keyword = line + strspn(line, " \t");
+        Associativity assoc = parse_associativity(keyword, strcspn(keyword, " \t"));
+        if (assoc != ASSOC_NONE) {
+            int level = ++num_precedence_levels;
+            for (const char *c = keyword + strcspn(keyword, " \t"); *c != 0; c++) {
+                if (*c != ' ' && *c != '\t') declare_precedence(intern_symbol(c, 1), level, assoc);
+            }
+            continue;
+        }
+
+        // Parse the rule (Example: "E -> E+T", or "E -> -E %prec u")
         char lhs;
-        char rhs_str[MAX_RHS] = {0};
+        char rhs_str[MAX_LINE] = {0};
         if (sscanf(line, " %c -> %s", &lhs, rhs_str) != 2) {
              printf("Error: Invalid rule format: %s\n", line);
              continue; // Skip invalid line
         }
+        if (!isupper(lhs)) { // Assuming non-terminals are uppercase
+             printf("Warning: LHS '%c' is not uppercase. Treating as non-terminal.\n", lhs);
+        }
+
+        // Process RHS, the dot position of an item must be able to reach its end
+        int rhs_len = strlen(rhs_str);
+        if (rhs_len > MAX_RHS) {
+            printf("Error: RHS longer than %d symbols in rule: %s\n", MAX_RHS, line);
+            continue;
+        }
+        if (strchr(rhs_str, EPSILON) != NULL) { // Handle epsilon
+            if (rhs_len != 1) {
+                printf("Error: Epsilon '%' must be the only symbol on RHS in rule: %s\n", line);
+                continue; // Skip this rule
+            }
+            rhs_len = 0; // Represent as empty RHS, epsilon itself is not a symbol
+        }
 
-        // --- Augmentation Logic ---
-        if (first_rule) {
-            original_start_symbol = lhs;
-            // Add the augmented rule S' -> S (using a symbol not in grammar, e.g., ASCII 1)
-            grammar[0].lhs = 1; // Use a special character for S'
-            grammar[0].rhs[0] = original_start_symbol;
-            grammar[0].length = 1;
-            num_rules = 1; // Start counting rules from 1 for user rules
+        char prec;
+        const char *prec_keyword = strstr(line, " %prec");
+        if (prec_keyword != NULL && sscanf(prec_keyword, " %%prec %c", &prec) != 1) {
+            printf("Error: %%prec without a symbol in rule: %s\n", line);
+            continue;
+        }
 
-            // Add S' to non-terminals
-            non_terminals[num_non_terminals++] = 1; 
-            first_rule = false; 
+        Rule rule = {(Symbol)intern_symbol(&lhs, 1), (Symbol *)arena_alloc(&grammar_arena, rhs_len * sizeof(Symbol)), rhs_len, END_SYMBOL};
+        for (int k = 0; k < rhs_len; k++) {
+            rule.rhs[k] = intern_symbol(&rhs_str[k], 1);
         }
-        // --- End Augmentation Logic ---
+        if (prec_keyword != NULL) rule.prec = intern_symbol(&prec, 1);
+        array_push(&grammar, rule);
+    }
+
+    end_grammar();
+}
 
+// Next token of a grammar file line: a quoted name ('+', "->") or a run of non-blank
+// characters; a '#' outside quotes starts a comment. Returns false at the end of the line.
+bool next_grammar_token(const char **p, const char **start, int *length, bool *quoted) {
+    while (isspace((unsigned char)**p)) (*p)++;
+    if (**p == 0 || **p == '#') return false;
 
-        // Add LHS to non-terminals if new
-        bool found = false;
-        for (int i = 0; i < num_non_terminals; i++) {
-            if (non_terminals[i] == lhs) {
-                found = true;
-                break;
+    *quoted = **p == '\'' || **p == '"';
+    if (*quoted) {
+        const char *close = strchr(*p + 1, **p);
+        if (close == NULL || close == *p + 1) return false;
+        *start = *p + 1;
+        *length = close - *start;
+        *p = close + 1;
+        return true;
+    }
+    *start = *p;
+    while (**p != 0 && !isspace((unsigned char)**p)) (*p)++;
+    *length = *p - *start;
+    return true;
+}
+
+// Read a grammar with named symbols from a file:
+//     # comment
+//     expr   -> expr '+' term | term
+//     term   -> term '*' factor
+//             | factor
+//     factor -> '(' expr ')' | NUM
+//     list   -> %empty | list NUM
+//     %left '+' '-'
+//     %left '*'
+//     %right UMINUS
+//     expr   -> '-' expr %prec UMINUS
+// Symbols are separated by blanks. The LHS of the first rule is the start symbol,
+// symbols that never appear on a LHS are terminals. Each %left, %right or %nonassoc
+// line declares one precedence level, binding tighter than the lines above it.
+void read_grammar_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Error: cannot open grammar file %s\n", path);
+        exit(1);
+    }
+    begin_grammar();
+    symbol_separator = " ";
+
+    char line[MAX_LINE];
+    Symbol rhs[MAX_RHS];
+    int line_number = 0;
+    int lhs = -1;  // LHS the alternatives on the current line belong to
+    while (fgets(line, MAX_LINE, file) != NULL) {
+        line_number++;
+        const char *p = line;
+        const char *token;
+        int length;
+        bool quoted;
+        if (!next_grammar_token(&p, &token, &length, &quoted)) continue;
+
+        // "%left a b ..." declares the next precedence level
+        Associativity assoc = quoted ? ASSOC_NONE : parse_associativity(token, length);
+        if (assoc != ASSOC_NONE) {
+            int level = ++num_precedence_levels;
+            while (next_grammar_token(&p, &token, &length, &quoted)) {
+                declare_precedence(intern_symbol(token, length), level, assoc);
             }
-        }
-        if (!found && isupper(lhs)) { // Assuming non-terminals are uppercase
-             if (num_non_terminals < MAX_SYMBOLS) {
-                non_terminals[num_non_terminals++] = lhs;
-             } else {
-                 printf("Warning: MAX_SYMBOLS reached for non-terminals.\n");
-             }
-        } else if (!isupper(lhs)) {
-             printf("Warning: LHS '%c' is not uppercase. Treating as non-terminal.\n", lhs);
-             // Optionally add logic to handle non-uppercase non-terminals if needed
-             if (!found) {
-                 if (num_non_terminals < MAX_SYMBOLS) non_terminals[num_non_terminals++] = lhs;
-             }
+            lhs = -1;
+            continue;
         }
 
+        // "A -> ..." starts the rules of A, "| ..." continues them
+        if (quoted || length != 1 || token[0] != '|') {
+            const char *arrow;
+            int arrow_length;
+            bool arrow_quoted;
+            const char *rest = p;
+            if (!next_grammar_token(&rest, &arrow, &arrow_length, &arrow_quoted) ||
+                arrow_quoted || arrow_length != 2 || strncmp(arrow, "->", 2) != 0) {
+                printf("Error: line %d: expected 'A -> ...' or '| ...': %s", line_number, line);
+                lhs = -1;
+                continue;
+            }
+            lhs = intern_symbol(token, length);
+            p = rest;
+        } else if (lhs == -1) {
+            printf("Error: line %d: '|' without a rule to continue\n", line_number);
+            continue;
+        }
 
-        // Process RHS
-        grammar[num_rules].lhs = lhs;
+        // Alternatives separated by '|', %empty or nothing for epsilon
         int rhs_len = 0;
-        for (int k = 0; rhs_str[k] != '\0' && k < MAX_RHS -1 ; k++) {
-            char symbol = rhs_str[k];
-            
-            if (symbol == EPSILON) { // Handle epsilon
-                 if (strlen(rhs_str) == 1) { // Only epsilon on RHS
-                     grammar[num_rules].length = 0; // Represent as empty RHS
-                     // Don't add epsilon itself to terminals/non-terminals
-                     rhs_len = 0; // Ensure length is 0
-                     break; 
-                 } else {
-                     printf("Error: Epsilon '%' must be the only symbol on RHS in rule: %s\n", line);
-                     // Skip this rule or handle error
-                     rhs_len = -1; // Mark as error
-                     break;
-                 }
-            }
-
-            grammar[num_rules].rhs[rhs_len++] = symbol;
-
-            // Add symbol to terminals/non-terminals if new
-            bool is_nt = false;
-            for(int nt_idx = 0; nt_idx < num_non_terminals; ++nt_idx) {
-                if (non_terminals[nt_idx] == symbol) {
-                    is_nt = true;
+        Symbol prec = END_SYMBOL;
+        bool more = true;
+        while (more) {
+            more = next_grammar_token(&p, &token, &length, &quoted);
+            bool bar = more && !quoted && length == 1 && token[0] == '|';
+            if (more && !bar) {
+                if (!quoted && length == (int)strlen(EMPTY_NAME) && strncmp(token, EMPTY_NAME, length) == 0) continue;
+                if (!quoted && length == 5 && strncmp(token, "%prec", 5) == 0) {
+                    if (!next_grammar_token(&p, &token, &length, &quoted)) {
+                        printf("Error: line %d: %%prec without a symbol\n", line_number);
+                        more = false;
+                    } else {
+                        prec = intern_symbol(token, length);
+                    }
+                    continue;
+                }
+                if (rhs_len == MAX_RHS) {
+                    printf("Error: line %d: RHS longer than %d symbols\n", line_number, MAX_RHS);
+                    rhs_len = -1;
                     break;
                 }
+                rhs[rhs_len++] = intern_symbol(token, length);
+                continue;
             }
 
-            if (!is_nt) { // If not already a non-terminal, check if it's a terminal
-                bool is_term = false;
-                 for(int t_idx = 0; t_idx < num_terminals; ++t_idx) {
-                     if (terminals[t_idx] == symbol) {
-                         is_term = true;
-                         break;
-                     }
-                 }
-                 if (!is_term) { // New terminal
-                     if (num_terminals < MAX_SYMBOLS) {
-                         terminals[num_terminals++] = symbol;
-                     } else {
-                          printf("Warning: MAX_SYMBOLS reached for terminals.\n");
-                     }
-                 }
-            }
-        }
-        
-        if (rhs_len != -1) { // Only increment rule count if rule was valid
-            grammar[num_rules].length = rhs_len;
-            num_rules++;
+            Rule rule = {(Symbol)lhs, (Symbol *)arena_alloc(&grammar_arena, rhs_len * sizeof(Symbol)), rhs_len, prec};
+            memcpy(rule.rhs, rhs, rhs_len * sizeof(Symbol));
+            array_push(&grammar, rule);
+            rhs_len = 0;
+            prec = END_SYMBOL;
         }
+    }
+    fclose(file);
 
-        if (num_rules >= MAX_RULES) {
-            printf("Warning: MAX_RULES reached.\n");
-            break;
-        }
+    end_grammar();
+}
+
+// Time sweep_first against digraph_first on a synthetic grammar with one long left-recursive
+// cycle A0 -> A1 x, A1 -> A2 x, ..., A(n-1) -> A0 x | y, where FIRST(y) crosses every rule
+void run_first_benchmark(int depth) {
+    begin_grammar();
+    symbol_separator = " ";
+    char name[32], next[32];
+    Symbol x = intern_symbol("x", 1), y = intern_symbol("y", 1);
+    for (int i = 0; i < depth; i++) {
+        int length = sprintf(name, "A%d", i);
+        int next_length = sprintf(next, "A%d", (i + 1) % depth);
+        Rule rule = {(Symbol)intern_symbol(name, length), (Symbol *)arena_alloc(&grammar_arena, 2 * sizeof(Symbol)), 2, END_SYMBOL};
+        rule.rhs[0] = intern_symbol(next, next_length);
+        rule.rhs[1] = x;
+        array_push(&grammar, rule);
     }
+    Rule exit_rule = {grammar[depth].lhs, (Symbol *)arena_alloc(&grammar_arena, sizeof(Symbol)), 1, END_SYMBOL};
+    exit_rule.rhs[0] = y;
+    array_push(&grammar, exit_rule);
+    end_grammar();
 
-     // Ensure the original start symbol is marked as non-terminal if not already
-     bool start_symbol_is_nt = false;
-     for (int i = 0; i < num_non_terminals; i++) {
-         if (non_terminals[i] == original_start_symbol) {
-             start_symbol_is_nt = true;
-             break;
-         }
-     }
-     if (!start_symbol_is_nt && original_start_symbol != 0) {
-          if (num_non_terminals < MAX_SYMBOLS) {
-              non_terminals[num_non_terminals++] = original_start_symbol;
-          } else {
-               printf("Warning: MAX_SYMBOLS reached for non-terminals (adding start symbol).\n");
-          }
-     }
+    bool *nullable = (bool *)calloc(num_symbols, sizeof(bool));
+    SymbolSet *swept = (SymbolSet *)calloc(num_symbols, sizeof(SymbolSet));
+    SymbolSet *digraph = (SymbolSet *)calloc(num_symbols, sizeof(SymbolSet));
+    compute_nullable(nullable);
+    for (int a = 0; a < num_terminals; a++) {
+        set_add(&swept[a], a);
+        set_add(&digraph[a], a);
+    }
+
+    clock_t start = clock();
+    int passes = sweep_first(swept, nullable);
+    double sweep_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    start = clock();
+    digraph_first(digraph, nullable);
+    double digraph_ms = (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+
+    bool same = memcmp(swept, digraph, num_symbols * sizeof(SymbolSet)) == 0;
+    printf("FIRST on a %d-rule left-recursive chain (%d non-terminals):\n", grammar.size, num_non_terminals);
+    printf("  sweep:   %.3f ms (%d passes over the rules)\n", sweep_ms, passes);
+    printf("  digraph: %.3f ms (each edge once)\n", digraph_ms);
+    printf("  results %s\n", same ? "identical" : "DIFFER");
+
+    free(nullable);
+    free(swept);
+    free(digraph);
 }
 
-int main() {
-    printf("LR(1) Parser Generator\n");
-    printf("======================\n\n");
-    
-    // Read grammar from user
-    read_grammar();
-    
-    // Calculate FIRST sets
-    bool first_sets[MAX_SYMBOLS][MAX_SYMBOLS] = {{false}};
-    compute_first_sets(first_sets);
-    
-    // Display FIRST sets for verification
-    printf("FIRST sets:\n");
-    for (int n = 0; n < num_non_terminals; n++) {
-        char nt = non_terminals[n];
-        printf("FIRST(%c) = { ", nt);
-        bool first = true;
-        for (int t = 0; t < MAX_SYMBOLS; t++) {
-            if (first_sets[nt][t]) {
-                if (!first) printf(", ");
-                if (t == EPSILON) {
-                    printf("epsilon");
-                } else {
-                    printf("%c", t);
-                }
-                first = false;
+int main(int argc, char **argv) {
+    // Command line options
+    bool use_packed = false;
+    BuildMode mode = BUILD_CANONICAL;
+    const char *grammar_path = NULL;
+    const char *cache_dir = NULL;
+    const char *emit_path = NULL;
+    bool use_ascent = false;
+    bool skip_units = false;
+    bool fuse = false;
+    const char *bench_path = NULL;
+    int bench_length = 0;
+    int bench_depth = 0;
+    char **batch_paths = NULL;
+    int num_batch_paths = 0;
+    bool count_steps = false;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--grammar") == 0 && a + 1 < argc) {
+            grammar_path = argv[++a];
+        } else if (strcmp(argv[a], "--cache") == 0 && a + 1 < argc) {
+            cache_dir = argv[++a];
+        } else if (strcmp(argv[a], "--emit") == 0 && a + 1 < argc) {
+            emit_path = argv[++a];
+        } else if (strcmp(argv[a], "--ascent") == 0) {
+            use_ascent = true;
+        } else if (strcmp(argv[a], "--emit-bench") == 0 && a + 2 < argc) {
+            bench_path = argv[++a];
+            bench_length = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--batch") == 0 && a + 1 < argc && strncmp(argv[a + 1], "--", 2) != 0) {
+            batch_paths = &argv[a + 1];
+            while (a + 1 < argc && strncmp(argv[a + 1], "--", 2) != 0) {
+                a++;
+                num_batch_paths++;
             }
+        } else if (strcmp(argv[a], "--count") == 0) {
+            count_steps = true;
+        } else if (strcmp(argv[a], "--bench-first") == 0 && a + 1 < argc) {
+            bench_depth = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--packed") == 0) {
+            use_packed = true;
+        } else if (strcmp(argv[a], "--skip-units") == 0) {
+            skip_units = true;
+        } else if (strcmp(argv[a], "--fuse") == 0) {
+            fuse = true;
+        } else if (strcmp(argv[a], "--lalr") == 0) {
+            mode = BUILD_LALR;
+        } else if (strcmp(argv[a], "--pager") == 0) {
+            mode = BUILD_PAGER;
+        } else {
+            printf("Usage: %s [--grammar FILE] [--lalr | --pager] [--packed] [--skip-units] [--fuse] [--cache DIR] [--emit PATH [--ascent]] [--emit-bench PATH N] [--batch FILE... [--count]] | --bench-first N\n", argv[0]);
+            printf("  --grammar read a grammar with named symbols from FILE instead of one-character rules\n");
+            printf("  --lalr    build the LALR(1) automaton instead of the canonical LR(1) one\n");
+            printf("  --pager   build a minimal LR(1) automaton (Pager's weak compatibility merging)\n");
+            printf("  --packed  compress the table into comb vectors and parse with it\n");
+            printf("  --skip-units  bypass the unit reductions (A -> B) in the GOTO table\n");
+            printf("  --fuse    fuse a shift with the reduction that always follows it into one action\n");
+            printf("  --cache   reuse the table stored in DIR for this grammar and mode, or store it there\n");
+            printf("  --emit    write a standalone parser with the packed table to PATH.h and PATH.cpp\n");
+            printf("  --ascent  with --emit, write a recursive-ascent parser (one function per state) instead\n");
+            printf("  --emit-bench PATH N  write both parsers and a benchmark on a random N-token sentence\n");
+            printf("  --batch FILE...  parse every line of the corpus files without tracing, print only counts,\n");
+            printf("                   rejected lines and throughput (with --packed, on the packed table)\n");
+            printf("  --count   with --batch, also count the driver steps, shifts and reductions\n");
+            printf("  --bench-first N  time the FIRST algorithms on an N-deep left-recursive chain and exit\n");
+            return 1;
         }
-        printf(" }\n");
     }
-    printf("\n");
-    
-    // Build LR(1) states
-    LR1State states[MAX_STATES];
-    int num_states = 0;
-    build_lr1_states(states, &num_states, first_sets);
+    if (bench_depth > 0) {
+        run_first_benchmark(bench_depth);
+        return 0;
+    }
+
+    // A batch run only reports on the corpus, not on the generator
+    bool quiet = batch_paths != NULL;
+    if (!quiet) {
+        printf("LR(1) Parser Generator\n");
+        printf("======================\n\n");
+    }
     
-    // Display states for verification
-    printf("Number of states: %d\n", num_states);
-    for (int i = 0; i < num_states; i++) {
-        print_state(states[i], i);
-        printf("\n");
+    // Read grammar from a file or from the user
+    if (grammar_path != NULL) {
+        read_grammar_file(grammar_path);
+    } else {
+        read_grammar(!quiet);
     }
     
-    // Build LR(1) table
+    // Look the table up in the cache: the grammar and build mode name the file
+    Array<char> normalized = {NULL, 0, 0};
+    char cache_path[MAX_LINE];
     LR1Table table;
-    build_lr1_table(states, num_states, &table, first_sets);
+    bool cached = false;
+    if (cache_dir != NULL) {
+        normalize_grammar(mode, skip_units, fuse, &normalized);
+        cache_file_path(cache_dir, &normalized, cache_path, sizeof(cache_path));
+        clock_t load_start = clock();
+        cached = load_cached_table(cache_path, &normalized, &table);
+        if (cached && !quiet) {
+            printf("%s table loaded from %s in %.3f ms\n\n", build_mode_names[mode], cache_path,
+                   (double)(clock() - load_start) * 1000.0 / CLOCKS_PER_SEC);
+        }
+    }
+
+    FirstSets first_sets = {};
+    static LR1Automaton automaton;
+    int num_states;
+    if (cached) {
+        num_states = table.num_states;
+    } else {
+        // Calculate FIRST sets
+        compute_first_sets(&first_sets);
+
+        // Display FIRST sets for verification
+        if (!quiet) print_first_sets(&first_sets);
+
+        // Build the states in the requested mode
+        clock_t build_start = clock();
+        switch (mode) {
+            case BUILD_CANONICAL: build_lr1_states(&automaton, END_SYMBOL, &first_sets); break;
+            case BUILD_LALR:      build_lalr1_states(&automaton, &first_sets); break;
+            case BUILD_PAGER:     build_pager_states(&automaton, &first_sets); break;
+        }
+        double build_ms = (double)(clock() - build_start) * 1000.0 / CLOCKS_PER_SEC;
+        num_states = automaton.states.size;
+
+        // Display states for verification
+        if (!quiet) {
+            printf("%s automaton built in %.3f ms\n", build_mode_names[mode], build_ms);
+            printf("Number of states: %d\n", num_states);
+            for (int i = 0; i < num_states; i++) {
+                print_state(&automaton, i);
+                printf("\n");
+            }
+        }
+
+        // Build LR(1) table
+        build_lr1_table(&automaton, &table, quiet);
+        if (skip_units || fuse) {
+            bool *reachable = (bool *)malloc(num_states * sizeof(bool));
+            int num_reachable = mark_reachable_states(&table, reachable);
+            if (skip_units) {
+                int rewritten = bypass_unit_reductions(&table);
+                int before = num_reachable;
+                num_reachable = mark_reachable_states(&table, reachable);
+                if (!quiet) printf("Unit reductions bypassed: %d GOTO entries rewritten, %d states no longer reachable\n",
+                       rewritten, before - num_reachable);
+            }
+            if (fuse) {
+                int fused = fuse_shift_reductions(&table);
+                int before = num_reachable;
+                num_reachable = mark_reachable_states(&table, reachable);
+                if (!quiet) printf("Shift-reduce actions: %d shifts fused, %d states no longer reachable\n",
+                       fused, before - num_reachable);
+            }
+            free(reachable);
+        }
+
+        // Store the table for the next run
+        if (cache_dir != NULL && !save_cached_table(cache_path, &normalized, &table)) {
+            printf("Warning: could not write the table cache %s\n", cache_path);
+        }
+    }
+    array_free(&normalized);
     
     // Display LR(1) table
-    print_table(&table, num_states);
+    if (!quiet) {
+        print_table(&table, num_states);
+        int num_consistent = 0;
+        for (int i = 0; i < num_states; i++) {
+            if (table.consistent[i] != 0) num_consistent++;
+        }
+        printf("Consistent states (reduce without reading the lookahead): %d of %d\n", num_consistent, num_states);
+    }
     
+    // Compress the table if requested, or to embed it in a generated parser
+    PackedTable packed;
+    bool need_packed = use_packed || (emit_path != NULL && !use_ascent) || bench_path != NULL;
+    if (need_packed) {
+        pack_table(&table, num_states, &packed);
+    }
+    if (use_packed && !quiet) {
+        print_packed_report(&table, &packed);
+    }
+    if (emit_path != NULL) {
+        if (use_ascent ? emit_ascent_parser(emit_path, &table, mode) : emit_parser(emit_path, &packed, mode)) {
+            printf("\nParser written to %s.h and %s.cpp\n", emit_path, emit_path);
+        } else {
+            printf("\nError: cannot write the parser to %s.h and %s.cpp\n", emit_path, emit_path);
+        }
+    }
+    if (bench_path != NULL) {
+        if (emit_benchmark(bench_path, &table, &packed, mode, bench_length)) {
+            printf("\nBenchmark written to %s_bench.cpp, build it with %s_table.cpp and %s_ascent.cpp\n",
+                   bench_path, bench_path, bench_path);
+        } else {
+            printf("\nError: cannot write the benchmark to %s_bench.cpp\n", bench_path);
+        }
+    }
+    
+    // Batch run: the corpus files instead of the prompt
+    if (quiet) {
+        NoTrace silent;
+        Counters counters = {0, 0, 0, 0};
+        bool ok;
+        if (use_packed) {
+            ok = count_steps ? run_batch(batch_paths, num_batch_paths, &packed, counters)
+                             : run_batch(batch_paths, num_batch_paths, &packed, silent);
+        } else {
+            ok = count_steps ? run_batch(batch_paths, num_batch_paths, &table, counters)
+                             : run_batch(batch_paths, num_batch_paths, &table, silent);
+        }
+        if (count_steps) {
+            long tokens = counters.shifts + counters.fused;
+            printf("driver: %ld steps, %ld shifts, %ld reductions, %ld shift-reduces", counters.steps,
+                   counters.shifts, counters.reductions, counters.fused);
+            if (tokens > 0) {
+                printf(" (%.2f steps and %.2f reductions per shifted token)", (double)counters.steps / tokens,
+                       (double)(counters.reductions + counters.fused) / tokens);
+            }
+            printf("\n");
+        }
+        if (need_packed) free_packed_table(&packed);
+        free_table(&table);
+        free_automaton(&automaton);
+        free_first_sets(&first_sets);
+        return ok ? 0 : 1;
+    }
+
     // Parse input strings
     char input[MAX_INPUT];
+    Array<Symbol> tokens = {NULL, 0, 0};
     printf("\nEnter strings to parse (append $ at the end, empty line to quit):\n");
     
     while (1) {
@@ -824,13 +3587,21 @@ int main() {
         }
         
         // Parse the input
-        if (parse_input(input, &table, num_states)) {
+        bool valid = tokenize_input(input, &tokens) &&
+                     (use_packed ? parse_input(input, tokens.data, &packed)
+                                 : parse_input(input, tokens.data, &table));
+        if (valid) {
             printf("\nResult: VALID - The input string is in the language!\n");
         } else {
             printf("\nResult: INVALID - The input string is not in the language.\n");
         }
     }
     
+    if (need_packed) free_packed_table(&packed);
+    free_table(&table);
+    free_automaton(&automaton);
+    free_first_sets(&first_sets);
+    array_free(&tokens);
     printf("Thank you for using the LR(1) Parser Generator!\n");
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,85 @@
+#!/bin/bash
+# Corrupt one header field or table entry of a valid table cache at a time and check that
+# Complete.cpp rejects the file, rebuilds the table with the same results and rewrites the cache.
+# Usage: tests/cache_corruption.sh [compiled Complete.cpp]; builds it with $CXX otherwise.
+
+parser=$1
+if [ -n "$parser" ]; then parser=$(cd "$(dirname "$parser")" && pwd)/$(basename "$parser"); fi
+cd "$(dirname "$0")/.." || exit 1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if [ -z "$parser" ]; then
+    parser=$work/complete
+    ${CXX:-g++} -O1 -Wno-format -o "$parser" Complete.cpp || exit 1
+fi
+
+printf 'E -> E + T | T\nT -> T * F | F\nF -> ( E ) | id\n' > "$work/etf.y"
+printf 'id + id * id $\n( id + id ) * id $\nid id $\n( id $\n' > "$work/inputs"
+
+# Run the parser on the inputs with the cache; prints the Result lines, then "loaded" on a hit
+run() {
+    "$parser" --grammar "$work/etf.y" --cache "$work/cache" < "$work/inputs" > "$work/out" 2>&1 || return 1
+    grep '^Result' "$work/out"
+    if grep -q 'table loaded from' "$work/out"; then echo loaded; fi
+}
+
+# Write a little-endian integer of a given byte width at a byte offset of a file
+patch() {
+    local file=$1 offset=$2 width=$3 value=$4 bytes="" i
+    for ((i = 0; i < width; i++)); do
+        bytes+=$(printf '\\x%02x' $(((value >> (8 * i)) & 0xff)))
+    done
+    printf "$bytes" | dd of="$file" bs=1 seek="$offset" conv=notrunc status=none
+}
+
+mkdir "$work/cache"
+expected=$(run) || { echo "FAIL: first run"; exit 1; }
+case "$expected" in *loaded*) echo "FAIL: first run hit an empty cache"; exit 1;; esac
+[ "$(run)" = "$expected"$'\nloaded' ] || { echo "FAIL: second run did not load the cache"; exit 1; }
+cache=$(ls "$work"/cache/*.lr1)
+cp "$cache" "$work/pristine"
+
+# Offsets of the table blocks, read from the header
+offset() { od -An -t u8 -j "$1" -N 8 "$cache" | tr -d ' '; }
+action=$(offset 48) goto=$(offset 56) rule_length=$(offset 64) rule_lhs=$(offset 72) consistent=$(offset 80)
+
+# name; byte offset (header fields, or an entry of a block); width; corrupt value.
+# ACTION entries are (value << 3) | type with types 1 shift, 2 reduce, 4 shift-reduce.
+cases=(
+    "num_states; 16; 4; 2147483647"
+    "negative num_states; 16; 4; -1"
+    "action_offset; 48; 8; 0x7fffffffffffff00"
+    "wrapping action_offset; 48; 8; -8"
+    "misaligned action_offset; 48; 8; 97"
+    "goto_offset; 56; 8; 0x7fffffff00"
+    "rule_length_offset; 64; 8; 0x7fffffff00"
+    "rule_lhs_offset; 72; 8; 0x7fffffff00"
+    "consistent_offset; 80; 8; 0x7fffffff00"
+    "action_offset in header; 48; 8; 8"
+    "ACTION shift to state 100000; action + 4; 4; 100000 << 3 | 1"
+    "ACTION reduce by rule 5000; action + 8; 4; 5000 << 3 | 2"
+    "ACTION shift-reduce by rule -1; action; 4; -1 << 3 | 4"
+    "ACTION of unknown type; action + 12; 4; 7"
+    "GOTO to state 100000; goto; 4; 100000"
+    "GOTO to state -5; goto + 4; 4; -5"
+    "consistent shift; consistent + 4; 4; 1 << 3 | 1"
+    "rule length; rule_length + 4; 4; 1000"
+    "rule LHS; rule_lhs + 2; 2; 0"
+)
+failures=0
+for entry in "${cases[@]}"; do
+    IFS=';' read -r name where width value <<< "$entry"
+    cp "$work/pristine" "$cache"
+    patch "$cache" $((where)) $((width)) $((value))
+    if [ "$(run)" != "$expected" ]; then
+        echo "FAIL: corrupt $name was not rejected and rebuilt"
+        failures=$((failures + 1))
+    elif [ "$(run)" != "$expected"$'\nloaded' ]; then
+        echo "FAIL: cache not rewritten after corrupt $name"
+        failures=$((failures + 1))
+    else
+        echo "ok: corrupt $name"
+    fi
+done
+exit $((failures > 0))
@@ -0,0 +1,58 @@
+#!/bin/bash
+# Parse every fixture of tests/grammars with Complete.cpp in each build mode and table option,
+# and check the Result lines against tests/expected. Also prints, per fixture and mode, the
+# state count, the consistent states and the automaton build time, so that these figures can
+# be compared between two versions of the generator.
+# A fixture is the interactive input: grammar rules, a blank line, then one string per line.
+# The expected results of g1-g5 and f1-f4 come from the original generator; big2 (23
+# precedence levels, 142 canonical states) was beyond its fixed limits. A fixture whose LALR(1)
+# results differ (g5 is LR(1) but not LALR(1)) has them in <name>.lalr.results.
+# Usage: tests/regression.sh [compiled Complete.cpp]; builds it with $CXX otherwise.
+
+parser=$1
+if [ -n "$parser" ]; then parser=$(cd "$(dirname "$parser")" && pwd)/$(basename "$parser"); fi
+cd "$(dirname "$0")/.." || exit 1
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if [ -z "$parser" ]; then
+    parser=$work/complete
+    ${CXX:-g++} -O2 -Wno-format -o "$parser" Complete.cpp || exit 1
+fi
+
+modes=(
+    ""
+    "--lalr"
+    "--pager"
+    "--packed"
+    "--skip-units"
+    "--fuse"
+    "--lalr --packed --skip-units --fuse"
+    "--cache $work/cache"
+    "--cache $work/cache"  # Second run loads the table stored by the first
+)
+
+failures=0
+for fixture in tests/grammars/*.in; do
+    name=$(basename "$fixture" .in)
+    rm -rf "$work/cache" && mkdir "$work/cache"
+    for mode in "${modes[@]}"; do
+        $parser $mode < "$fixture" > "$work/out" 2>&1
+        label=${mode/$work\/cache/DIR}
+        expected=tests/expected/$name.results
+        if [[ $mode == *--lalr* && -f tests/expected/$name.lalr.results ]]; then
+            expected=tests/expected/$name.lalr.results
+        fi
+        if ! grep '^Result' "$work/out" | cmp -s - "$expected"; then
+            echo "FAIL: $name ${label:-(canonical)}"
+            failures=$((failures + 1))
+            continue
+        fi
+        states=$(sed -n 's/^Number of states: //p' "$work/out")
+        consistent=$(sed -n 's/^Consistent states.*: \([0-9]*\) of.*/\1/p' "$work/out")
+        built=$(sed -n 's/.* built in \(.*\)/\1/p; s/.* loaded from .* in \(.*\)/loaded in \1/p' "$work/out")
+        printf "ok: %-5s %-36s %4s states, %3s consistent, %s\n" "$name" "${label:-(canonical)}" \
+               "${states:--}" "$consistent" "$built"
+    done
+done
+exit $((failures > 0))